@@ -1,43 +1,17 @@
 #include "DvbData.h"
 #include "client.h"
 #include "platform/util/util.h"
+#include "platform/util/timeutils.h"
 #include "tinyxml/tinyxml.h"
 #include "tinyxml/XMLUtils.h"
 #include <inttypes.h>
 #include <set>
 #include <iterator>
-#include <sstream>
 #include <algorithm>
 
 using namespace ADDON;
 using namespace PLATFORM;
 
-template <class ContainerT>
-void tokenize(const CStdString& str, ContainerT& tokens,
-    const CStdString& delimiters = " ", const bool trimEmpty = false)
-{
-  CStdString::size_type pos, lastPos = 0;
-  while (true)
-  {
-    pos = str.find_first_of(delimiters, lastPos);
-    if (pos == CStdString::npos)
-    {
-      pos = str.length();
-
-      if (pos != lastPos || !trimEmpty)
-        tokens.push_back(typename ContainerT::value_type(str.data() + lastPos, pos - lastPos));
-      break;
-    }
-    else
-    {
-      if (pos != lastPos || !trimEmpty)
-        tokens.push_back(typename ContainerT::value_type(str.data() + lastPos, pos - lastPos));
-    }
-    lastPos = pos + 1;
-  }
-};
-
-
 Dvb::Dvb()
   : m_connected(false), m_backendVersion(0)
 {
@@ -53,6 +27,9 @@ Dvb::Dvb()
   m_updateTimers = false;
   m_updateEPG    = false;
   m_tsBuffer     = NULL;
+
+  m_epgStoreStart = m_epgStoreEnd = 0;
+  m_epgStoreTime  = 0;
 }
 
 Dvb::~Dvb()
@@ -173,78 +150,49 @@ PVR_ERROR Dvb::GetChannels(ADDON_HANDLE handle, bool bRadio)
   return PVR_ERROR_NO_ERROR;
 }
 
-//TODO: rewrite
 //TODO: missing epg v2 - there's no documention
 PVR_ERROR Dvb::GetEPGForChannel(ADDON_HANDLE handle,
   const PVR_CHANNEL& channel, time_t iStart, time_t iEnd)
 {
   DvbChannel *myChannel = m_channels[channel.iUniqueId - 1];
 
-  CStdString url = BuildURL("api/epg.html?lvl=2&channel=%"PRIu64"&start=%f&end=%f",
-      myChannel->epgId, iStart/86400.0 + DELPHI_DATE, iEnd/86400.0 + DELPHI_DATE);
-  CStdString req = GetHttpXML(url);
-
-  TiXmlDocument doc;
-  doc.Parse(req);
-  if (doc.Error())
+  DvbEPGEntries_t entries;
+  if (!TakeStoredEPG(myChannel->epgId, iStart, iEnd, entries))
   {
-    XBMC->Log(LOG_ERROR, "Unable to parse EPG. Error: %s",
-        doc.ErrorDesc());
-    return PVR_ERROR_SERVER_ERROR;
+    CStdString url = BuildURL("api/epg.html?lvl=2&channel=%"PRIu64"&start=%f&end=%f",
+        myChannel->epgId, iStart/86400.0 + DELPHI_DATE, iEnd/86400.0 + DELPHI_DATE);
+    CStdString req = GetHttpXML(url);
+
+    DvbEPGStore_t store;
+    if (!ParseEPG(req, store))
+      return PVR_ERROR_SERVER_ERROR;
+    for (DvbEPGStore_t::iterator it = store.begin(); it != store.end(); ++it)
+      entries.insert(entries.end(), it->second.begin(), it->second.end());
   }
 
   unsigned iNumEPG = 0;
-  for (TiXmlElement *xEntry = doc.RootElement()->FirstChildElement("programme");
-      xEntry; xEntry = xEntry->NextSiblingElement("programme"))
+  for (DvbEPGEntries_t::iterator entry = entries.begin();
+      entry != entries.end(); ++entry)
   {
-    DvbEPGEntry entry;
-    entry.iChannelUid = channel.iUniqueId;
-    entry.startTime = ParseDateTime(xEntry->Attribute("start"));
-    entry.endTime = ParseDateTime(xEntry->Attribute("stop"));
-
-    if (iEnd > 1 && iEnd < entry.endTime)
-       continue;
-
-    if (!XMLUtils::GetInt(xEntry, "eventid", entry.iEventId))
-      continue;
-
-    // since RS 1.26.0 the correct language is already merged into the elements
-    TiXmlNode *xTitles = xEntry->FirstChild("titles");
-    if (!xTitles || !XMLUtils::GetString(xTitles, "title", entry.strTitle))
+    if (entry->endTime <= iStart)
       continue;
-
-    TiXmlNode *xDescriptions = xEntry->FirstChild("descriptions");
-    if (xDescriptions)
-      XMLUtils::GetString(xDescriptions, "description", entry.strPlot);
-
-    TiXmlNode *xEvents = xEntry->FirstChild("events");
-    if (xEvents)
-    {
-      XMLUtils::GetString(xEvents, "event", entry.strPlotOutline);
-      if (!entry.strPlotOutline.empty() && entry.strPlot.empty())
-        entry.strPlot = entry.strPlotOutline;
-    }
-
-    XMLUtils::GetUInt(xEntry, "content", entry.genre);
+    if (iEnd > 1 && iEnd < entry->endTime)
+       continue;
 
     EPG_TAG broadcast;
     memset(&broadcast, 0, sizeof(EPG_TAG));
-    broadcast.iUniqueBroadcastId  = entry.iEventId;
-    broadcast.strTitle            = entry.strTitle.c_str();
+    broadcast.iUniqueBroadcastId  = entry->iEventId;
+    broadcast.strTitle            = entry->strTitle.c_str();
     broadcast.iChannelNumber      = channel.iChannelNumber;
-    broadcast.startTime           = entry.startTime;
-    broadcast.endTime             = entry.endTime;
-    broadcast.strPlotOutline      = entry.strPlotOutline.c_str();
-    broadcast.strPlot             = entry.strPlot.c_str();
-    broadcast.iGenreType          = entry.genre & 0xF0;
-    broadcast.iGenreSubType       = entry.genre & 0x0F;
+    broadcast.startTime           = entry->startTime;
+    broadcast.endTime             = entry->endTime;
+    broadcast.strPlotOutline      = entry->strPlotOutline.c_str();
+    broadcast.strPlot             = entry->strPlot.c_str();
+    broadcast.iGenreType          = entry->genre & 0xF0;
+    broadcast.iGenreSubType       = entry->genre & 0x0F;
 
     PVR->TransferEpgEntry(handle, &broadcast);
     ++iNumEPG;
-
-    XBMC->Log(LOG_DEBUG, "%s loaded EPG entry '%u:%s': start=%u, end=%u",
-        __FUNCTION__, broadcast.iUniqueBroadcastId, broadcast.strTitle,
-        entry.startTime, entry.endTime);
   }
 
   XBMC->Log(LOG_INFO, "Loaded %u EPG entries for channel '%s'",
@@ -654,6 +602,7 @@ bool Dvb::LoadChannels()
   XMLUtils::GetString(root, (g_useRTSP) ? "rtspURL" : "upnpURL", streamURL);
 
   m_channels.clear();
+  m_channelUids.clear();
   m_channelAmount = 0;
   m_groups.clear();
   m_groupAmount = 0;
@@ -715,6 +664,10 @@ bool Dvb::LoadChannels()
         // so generate our own unique ids, at least for this session
         channel->id = m_channels.size() + 1;
         m_channels.push_back(channel);
+        // the first channel using a backend id wins
+        for (std::list<uint64_t>::iterator it = channel->backendIds.begin();
+            it != channel->backendIds.end(); ++it)
+          m_channelUids.insert(std::make_pair(*it, channel->id));
         group->channels.push_back(channel);
         if (!channel->hidden)
           ++m_channelAmount;
@@ -769,6 +722,17 @@ bool Dvb::LoadChannels()
      *    ...
      *  </settings>
      */
+    /* legacy support for old 32bit channel ids */
+    std::map<uint64_t, unsigned int> legacyUids;
+    for (std::map<uint64_t, unsigned int>::iterator it = m_channelUids.begin();
+        it != m_channelUids.end(); ++it)
+    {
+      std::pair<std::map<uint64_t, unsigned int>::iterator, bool> legacy =
+        legacyUids.insert(std::make_pair(it->first & 0xFFFFFFFF, it->second));
+      if (!legacy.second && it->second < legacy.first->second)
+        legacy.first->second = it->second;
+    }
+
     for (TiXmlElement *xSection = doc.RootElement()->FirstChildElement("section");
         xSection; xSection = xSection->NextSiblingElement("section"))
     {
@@ -790,51 +754,28 @@ bool Dvb::LoadChannels()
           continue;
         }
 
-        uint64_t backendId = 0;
-        std::istringstream ss(xEntry->GetText());
-        ss >> backendId;
+        const char *channelName = NULL;
+        uint64_t backendId = ParseChannelString(xEntry->GetText(), &channelName);
         if (!backendId)
           continue;
 
-        for (DvbChannels_t::iterator it = m_channels.begin();
-            it != m_channels.end(); ++it)
+        std::map<uint64_t, unsigned int> &uids = (backendId > 0xFFFFFFFF)
+          ? m_channelUids : legacyUids;
+        std::map<uint64_t, unsigned int>::iterator uid = uids.find(backendId);
+        if (uid == uids.end())
+          continue;
+
+        DvbChannel *channel = m_channels[uid->second - 1];
+        channel->hidden = false;
+        channel->frontendNr = ++m_channelAmount;
+        if (channelName)
+          channel->name = ConvertToUtf8(channelName);
+
+        if (group)
         {
-          DvbChannel *channel = *it;
-          bool found = false;
-
-          for (std::list<uint64_t>::iterator it2 = channel->backendIds.begin();
-              it2 != channel->backendIds.end(); ++it2)
-          {
-            /* legacy support for old 32bit channel ids */
-            uint64_t channelId = (backendId > 0xFFFFFFFF) ? *it2 :
-              *it2 & 0xFFFFFFFF;
-            if (channelId == backendId)
-            {
-              found = true;
-              break;
-            }
-          }
-
-          if (found)
-          {
-            channel->hidden = false;
-            channel->frontendNr = ++m_channelAmount;
-            if (!ss.eof())
-            {
-              ss.ignore(1);
-              CStdString channelName;
-              getline(ss, channelName);
-              channel->name = ConvertToUtf8(channelName);
-            }
-
-            if (group)
-            {
-              group->channels.push_back(channel);
-              if (!channel->radio)
-                group->radio = false;
-            }
-            break;
-          }
+          group->channels.push_back(channel);
+          if (!channel->radio)
+            group->radio = false;
         }
       }
     }
@@ -940,21 +881,28 @@ DvbTimers_t Dvb::LoadTimers()
   return timers;
 }
 
-//TODO: rewrite
 void Dvb::TimerUpdates()
 {
   for (DvbTimers_t::iterator timer = m_timers.begin();
       timer != m_timers.end(); ++timer)
     timer->iUpdateState = DVB_UPDATE_STATE_NONE;
 
+  typedef std::multimap<uint64_t, DvbTimer *> DvbTimerIndex_t;
+  DvbTimerIndex_t index;
+  for (DvbTimers_t::iterator timer = m_timers.begin();
+      timer != m_timers.end(); ++timer)
+    index.insert(std::make_pair(timer->hash(), &*timer));
+
   DvbTimers_t newtimers = LoadTimers();
   unsigned int updated = 0, unchanged = 0;
   for (DvbTimers_t::iterator newtimer = newtimers.begin();
       newtimer != newtimers.end(); ++newtimer)
   {
-    for (DvbTimers_t::iterator timer = m_timers.begin();
-        timer != m_timers.end(); ++timer)
+    std::pair<DvbTimerIndex_t::iterator, DvbTimerIndex_t::iterator> range =
+      index.equal_range(newtimer->hash());
+    for (DvbTimerIndex_t::iterator it = range.first; it != range.second; ++it)
     {
+      DvbTimer *timer = it->second;
       if (!timer->like(*newtimer))
         continue;
 
@@ -1078,6 +1026,274 @@ int Dvb::GetTimerId(const PVR_TIMER& timer)
 }
 
 
+bool Dvb::LoadEPG(time_t start, time_t end)
+{
+  int64_t loadStart = GetTimeMs();
+
+  CStdString url = BuildURL("api/epg.html?lvl=2&start=%f&end=%f",
+      start/86400.0 + DELPHI_DATE, end/86400.0 + DELPHI_DATE);
+  CStdString req = GetHttpXML(url);
+
+  DvbEPGStore_t store;
+  if (!ParseEPG(req, store))
+    return false;
+
+  // channels without any entry are covered as well
+  for (DvbChannels_t::iterator it = m_channels.begin();
+      it != m_channels.end(); ++it)
+  {
+    if (!(*it)->hidden)
+      store[(*it)->epgId];
+  }
+
+  m_epgStore.swap(store);
+  m_epgStoreStart = start;
+  m_epgStoreEnd   = end;
+
+  XBMC->Log(LOG_DEBUG, "%s loaded the guide of %lu channels (%lu bytes) in %d ms",
+      __FUNCTION__, (unsigned long)m_epgStore.size(), (unsigned long)req.length(),
+      (int)(GetTimeMs() - loadStart));
+  return true;
+}
+
+/*
+ * Hands out the stored guide of a channel. The guide of all channels is
+ * fetched with a single request for the first channel of an EPG update, the
+ * following channels of the same update are served from memory. Each
+ * channel's entries are handed out once, later requests go to the backend.
+ */
+bool Dvb::TakeStoredEPG(uint64_t epgId, time_t start, time_t end,
+    DvbEPGEntries_t& entries)
+{
+  // keep the per channel requests in low performance mode, the guide of
+  // all channels can be large
+  if (g_lowPerformance)
+    return false;
+
+  CLockObject lock(m_epgMutex);
+
+  if (m_epgStoreTime == 0 || GetTimeMs() - m_epgStoreTime > EPG_BULK_INTERVAL)
+  {
+    m_epgStore.clear();
+    m_epgStoreTime = GetTimeMs();
+    if (!LoadEPG(start, end))
+      return false;
+  }
+
+  if (start < m_epgStoreStart || (end > 1 && end > m_epgStoreEnd))
+    return false;
+
+  DvbEPGStore_t::iterator it = m_epgStore.find(epgId);
+  if (it == m_epgStore.end())
+    return false;
+
+  entries.swap(it->second);
+  m_epgStore.erase(it);
+  return true;
+}
+
+static inline bool IsTagEnd(char c)
+{
+  return c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* like xml.find(pattern, pos), but doesn't look at or past end */
+static size_t FindInRange(const CStdString& xml, size_t pos, size_t end,
+    const char *pattern)
+{
+  const char *first = xml.c_str() + pos;
+  const char *last  = xml.c_str() + end;
+  const char *found = std::search(first, last, pattern, pattern + strlen(pattern));
+  return (found == last) ? CStdString::npos : found - xml.c_str();
+}
+
+/* returns the value of the attribute 'pattern' (e.g. ' start="') inside the tag [pos, end) */
+static const char *FindAttribute(const CStdString& xml, size_t pos, size_t end,
+    const char *pattern)
+{
+  pos = FindInRange(xml, pos, end, pattern);
+  if (pos == CStdString::npos)
+    return NULL;
+  return xml.c_str() + pos + strlen(pattern);
+}
+
+static void AppendUTF8(CStdString& value, unsigned long code)
+{
+  if (code < 0x80)
+    value += (char)code;
+  else if (code < 0x800)
+  {
+    value += (char)(0xC0 | (code >> 6));
+    value += (char)(0x80 | (code & 0x3F));
+  }
+  else if (code < 0x10000)
+  {
+    value += (char)(0xE0 | (code >> 12));
+    value += (char)(0x80 | ((code >> 6) & 0x3F));
+    value += (char)(0x80 | (code & 0x3F));
+  }
+  else
+  {
+    value += (char)(0xF0 | (code >> 18));
+    value += (char)(0x80 | ((code >> 12) & 0x3F));
+    value += (char)(0x80 | ((code >> 6) & 0x3F));
+    value += (char)(0x80 | (code & 0x3F));
+  }
+}
+
+/* copies element text, resolving entities and condensing white space like TinyXML */
+static void DecodeText(const CStdString& xml, size_t pos, size_t end,
+    CStdString& value)
+{
+  bool space = false;
+
+  value.clear();
+  for (; pos < end; ++pos)
+  {
+    char c = xml[pos];
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+      space = true;
+      continue;
+    }
+    if (space && !value.empty())
+      value += ' ';
+    space = false;
+
+    size_t semi;
+    if (c != '&' || (semi = FindInRange(xml, pos, end, ";")) == CStdString::npos || semi - pos > 10)
+    {
+      value += c;
+      continue;
+    }
+
+    const char *entity = xml.c_str() + pos + 1;
+    size_t len = semi - pos - 1;
+    if (len == 3 && strncmp(entity, "amp", 3) == 0)
+      value += '&';
+    else if (len == 2 && strncmp(entity, "lt", 2) == 0)
+      value += '<';
+    else if (len == 2 && strncmp(entity, "gt", 2) == 0)
+      value += '>';
+    else if (len == 4 && strncmp(entity, "quot", 4) == 0)
+      value += '"';
+    else if (len == 4 && strncmp(entity, "apos", 4) == 0)
+      value += '\'';
+    else if (len > 1 && entity[0] == '#')
+      AppendUTF8(value, (entity[1] == 'x' || entity[1] == 'X')
+          ? strtoul(entity + 2, NULL, 16) : strtoul(entity + 1, NULL, 10));
+    else
+    {
+      value += c;
+      continue;
+    }
+    pos = semi;
+  }
+}
+
+/* finds the first <name> element inside [pos, end), false if there is none or it's empty */
+static bool GetElementText(const CStdString& xml, size_t pos, size_t end,
+    const char *tag, CStdString& value)
+{
+  size_t len = strlen(tag);
+  while ((pos = FindInRange(xml, pos, end, tag)) != CStdString::npos)
+  {
+    if (!IsTagEnd(xml[pos + len]))
+    {
+      pos += len;
+      continue;
+    }
+
+    size_t tagEnd = xml.find('>', pos);
+    if (tagEnd >= end || xml[tagEnd - 1] == '/')
+      break;
+    size_t valueEnd = xml.find('<', tagEnd + 1);
+    if (valueEnd > end)
+      break;
+
+    DecodeText(xml, tagEnd + 1, valueEnd, value);
+    return !value.empty();
+  }
+  value.clear();
+  return false;
+}
+
+static bool CompareEPGStart(const DvbEPGEntry& a, const DvbEPGEntry& b)
+{
+  return a.startTime < b.startTime;
+}
+
+/*
+ * Walks the <programme> elements of an epg.html reply in place instead of
+ * building a DOM, the guide of all channels easily is tens of megabytes.
+ */
+bool Dvb::ParseEPG(const CStdString& xml, DvbEPGStore_t& store)
+{
+  int64_t parseStart = GetTimeMs();
+
+  size_t pos = xml.find('<');
+  if (pos == CStdString::npos)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to parse EPG. Error: empty reply");
+    return false;
+  }
+
+  unsigned int iNumEPG = 0;
+  CStdString value;
+  time_t wallHour = 0, localHour = 0;
+  while ((pos = xml.find("<programme", pos)) != CStdString::npos)
+  {
+    size_t tagEnd = xml.find('>', pos);
+    size_t end = xml.find("</programme>", pos);
+    if (tagEnd == CStdString::npos || end == CStdString::npos)
+      break;
+    if (!IsTagEnd(xml[pos + strlen("<programme")]) || xml[tagEnd - 1] == '/')
+    {
+      pos = tagEnd;
+      continue;
+    }
+
+    DvbEPGEntry entry;
+    entry.iChannelUid = 0;
+    const char *start   = FindAttribute(xml, pos, tagEnd, " start=\"");
+    const char *stop    = FindAttribute(xml, pos, tagEnd, " stop=\"");
+    const char *channel = FindAttribute(xml, pos, tagEnd, " channel=\"");
+    pos = end + strlen("</programme>");
+
+    if (!start || !stop)
+      continue;
+    entry.startTime = ParseEPGDateTime(start, wallHour, localHour);
+    entry.endTime   = ParseEPGDateTime(stop, wallHour, localHour);
+
+    if (!GetElementText(xml, tagEnd, end, "<eventid", value))
+      continue;
+    entry.iEventId = atoi(value.c_str());
+
+    // since RS 1.26.0 the correct language is already merged into the elements
+    if (!GetElementText(xml, tagEnd, end, "<title", entry.strTitle))
+      continue;
+
+    GetElementText(xml, tagEnd, end, "<description", entry.strPlot);
+    if (GetElementText(xml, tagEnd, end, "<event", entry.strPlotOutline)
+        && entry.strPlot.empty())
+      entry.strPlot = entry.strPlotOutline;
+
+    if (GetElementText(xml, tagEnd, end, "<content", value))
+      entry.genre = atol(value.c_str());
+
+    uint64_t epgId = (channel) ? strtoumax(channel, NULL, 10) : 0;
+    store[epgId].push_back(entry);
+    ++iNumEPG;
+  }
+
+  for (DvbEPGStore_t::iterator it = store.begin(); it != store.end(); ++it)
+    std::sort(it->second.begin(), it->second.end(), CompareEPGStart);
+
+  XBMC->Log(LOG_DEBUG, "%s parsed %u EPG entries (%lu bytes) in %d ms",
+      __FUNCTION__, iNumEPG, (unsigned long)xml.length(), (int)(GetTimeMs() - parseStart));
+  return true;
+}
+
 void Dvb::RemoveNullChars(CStdString& str)
 {
   /* favourites.xml and timers.xml sometimes have null chars that screw the xml */
@@ -1201,36 +1417,97 @@ time_t Dvb::ParseDateTime(const CStdString& date, bool iso8601)
   return mktime(&timeinfo);
 }
 
-uint64_t Dvb::ParseChannelString(const CStdString& str, CStdString& channelName)
+static const int daysBeforeMonth[12] =
+  { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+static inline int LeapDaysBefore(int year)
+{
+  --year;
+  return year / 4 - year / 100 + year / 400;
+}
+
+static inline bool ParseDigits(const char *str, int count, int& value)
 {
-  std::vector<CStdString> tokenlist;
-  tokenize<std::vector<CStdString> >(str, tokenlist, "|");
-  if (tokenlist.size() < 1)
+  value = 0;
+  for (int i = 0; i < count; ++i)
   {
-    XBMC->Log(LOG_ERROR, "Unable to parse channel string: %s", str.c_str());
-    return 0;
+    if (str[i] < '0' || str[i] > '9')
+      return false;
+    value = value * 10 + (str[i] - '0');
+  }
+  return true;
+}
+
+/*
+ * Converts an epg.html date ("YYYYMMDDhhmmss +hhmm") as local time, like
+ * ParseDateTime does. mktime is costly when called for every entry of the
+ * guide, so it only runs once per wall clock hour: wallHour/localHour keep
+ * the last hour converted, as if it was UTC and as local time. DST changes
+ * happen on the hour, so the minutes and seconds are just added.
+ */
+time_t Dvb::ParseEPGDateTime(const char* date, time_t& wallHour, time_t& localHour)
+{
+  int year, mon, mday, hour, min, sec;
+  if (!ParseDigits(date, 4, year) || !ParseDigits(date + 4, 2, mon)
+      || !ParseDigits(date + 6, 2, mday) || !ParseDigits(date + 8, 2, hour)
+      || !ParseDigits(date + 10, 2, min) || !ParseDigits(date + 12, 2, sec)
+      || mon < 1 || mon > 12)
+    return ParseDateTime(CStdString(date, strcspn(date, "\"")));
+
+  bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  long days = (year - 1970) * 365L + LeapDaysBefore(year) - LeapDaysBefore(1970)
+    + daysBeforeMonth[mon - 1] + ((leap && mon > 2) ? 1 : 0) + mday - 1;
+  time_t wall = (time_t)(days * DAY_SECS + hour * 3600);
+
+  if (wall != wallHour || localHour == 0)
+  {
+    struct tm timeinfo;
+    memset(&timeinfo, 0, sizeof(tm));
+    timeinfo.tm_year  = year - 1900;
+    timeinfo.tm_mon   = mon - 1;
+    timeinfo.tm_mday  = mday;
+    timeinfo.tm_hour  = hour;
+    timeinfo.tm_isdst = -1;
+    wallHour  = wall;
+    localHour = mktime(&timeinfo);
   }
 
+  return localHour + min * 60 + sec;
+}
+
+/*
+ * Parses "<channel id>|<channel name>" in place. channelName (if given)
+ * points behind the separator or is NULL if the string has no name.
+ */
+uint64_t Dvb::ParseChannelString(const char* str, const char** channelName)
+{
+  if (channelName)
+    *channelName = NULL;
+  if (!str)
+    return 0;
+
+  const char *pos = str;
+  while (*pos == ' ' || *pos == '\t')
+    ++pos;
+
   uint64_t channelId = 0;
-  std::istringstream ss(tokenlist[0]);
-  ss >> channelId;
-  if (ss.fail())
+  const char *digits = pos;
+  for (; *pos >= '0' && *pos <= '9'; ++pos)
+    channelId = channelId * 10 + (*pos - '0');
+  if (pos == digits)
   {
-    XBMC->Log(LOG_ERROR, "Unable to parse channel id: %s",
-        tokenlist[0].c_str());
+    XBMC->Log(LOG_ERROR, "Unable to parse channel id: %s", str);
     return 0;
   }
 
-  channelName.clear();
-  if (tokenlist.size() >= 2)
-    channelName = ConvertToUtf8(tokenlist[1]);
+  if (channelName && *pos == '|')
+    *channelName = pos + 1;
   return channelId;
 }
 
-unsigned int Dvb::GetChannelUid(const CStdString& str)
+unsigned int Dvb::GetChannelUid(const char* str)
 {
-  CStdString channelName;
-  uint64_t channelId = ParseChannelString(str, channelName);
+  uint64_t channelId = ParseChannelString(str);
   if (channelId == 0)
     return 0;
   return GetChannelUid(channelId);
@@ -1238,18 +1515,10 @@ unsigned int Dvb::GetChannelUid(const CStdString& str)
 
 unsigned int Dvb::GetChannelUid(const uint64_t channelId)
 {
-  for (DvbChannels_t::iterator it = m_channels.begin();
-      it != m_channels.end(); ++it)
-  {
-    DvbChannel *channel = *it;
-    for (std::list<uint64_t>::iterator backendId = channel->backendIds.begin();
-        backendId != channel->backendIds.end(); backendId++)
-    {
-      if (channelId == *backendId)
-        return channel->id;
-    }
-  }
-  return 0;
+  std::map<uint64_t, unsigned int>::iterator it = m_channelUids.find(channelId);
+  if (it == m_channelUids.end())
+    return 0;
+  return it->second;
 }
 
 CStdString Dvb::BuildURL(const char* path, ...)
@@ -8,6 +8,8 @@
 #include "platform/util/StdString.h"
 #include "platform/threads/threads.h"
 #include <list>
+#include <vector>
+#include <map>
 
 #define CHANNELDAT_HEADER_SIZE       (7)
 #define ENCRYPTED_FLAG               (1 << 0)
@@ -17,6 +19,7 @@
 #define ADDITIONAL_AUDIO_TRACK_FLAG  (1 << 7)
 #define DAY_SECS                     (24 * 60 * 60)
 #define DELPHI_DATE                  (25569)
+#define EPG_BULK_INTERVAL            (10 * 60 * 1000)
 
 // minimum version required
 #define RS_VERSION_MAJOR   1
@@ -96,9 +99,22 @@ class DvbTimer
 public:
   DvbTimer()
   {
+    iEpgId       = 0;
     iUpdateState = DVB_UPDATE_STATE_NEW;
   }
 
+  /*!< @brief timers which are like() each other share the same hash */
+  uint64_t hash() const
+  {
+    uint64_t h = startTime;
+    h = h * 31 + endTime;
+    h = h * 31 + iChannelUid;
+    h = h * 31 + bRepeating;
+    h = h * 31 + iWeekdays;
+    h = h * 31 + iEpgId;
+    return h;
+  }
+
   bool like(const DvbTimer& right) const
   {
     bool bChanged = true;
@@ -172,6 +188,9 @@ public:
 typedef std::vector<DvbChannel *> DvbChannels_t;
 typedef std::vector<DvbGroup> DvbGroups_t;
 typedef std::vector<DvbTimer> DvbTimers_t;
+typedef std::vector<DvbEPGEntry> DvbEPGEntries_t;
+/*!< @brief EPG entries by channel epg id, sorted by start time */
+typedef std::map<uint64_t, DvbEPGEntries_t> DvbEPGStore_t;
 
 class Dvb
   : public PLATFORM::CThread
@@ -224,14 +243,18 @@ private:
   void TimerUpdates();
   void GenerateTimer(const PVR_TIMER& timer, bool newtimer = true);
   int GetTimerId(const PVR_TIMER& timer);
+  bool LoadEPG(time_t start, time_t end);
+  bool TakeStoredEPG(uint64_t epgId, time_t start, time_t end, DvbEPGEntries_t& entries);
+  bool ParseEPG(const CStdString& xml, DvbEPGStore_t& store);
 
   // helper functions
   void RemoveNullChars(CStdString& str);
   bool CheckBackendVersion();
   bool UpdateBackendStatus(bool updateSettings = false);
   time_t ParseDateTime(const CStdString& strDate, bool iso8601 = true);
-  uint64_t ParseChannelString(const CStdString& str, CStdString& channelName);
-  unsigned int GetChannelUid(const CStdString& str);
+  time_t ParseEPGDateTime(const char* date, time_t& wallHour, time_t& localHour);
+  uint64_t ParseChannelString(const char* str, const char** channelName = NULL);
+  unsigned int GetChannelUid(const char* str);
   unsigned int GetChannelUid(const uint64_t channelId);
   CStdString BuildURL(const char* path, ...);
   CStdString BuildExtURL(const CStdString& baseURL, const char* path, ...);
@@ -252,6 +275,8 @@ private:
   /* channels + active (not hidden) channels */
   DvbChannels_t m_channels;
   unsigned int m_channelAmount;
+  /* backend id -> channel uid */
+  std::map<uint64_t, unsigned int> m_channelUids;
 
   /* channel groups + active (not hidden) groups */
   DvbGroups_t m_groups;
@@ -265,6 +290,13 @@ private:
   DvbTimers_t m_timers;
   unsigned int m_newTimerIndex;
 
+  /* guide of all channels, fetched at once and handed out per channel */
+  DvbEPGStore_t m_epgStore;
+  time_t m_epgStoreStart;
+  time_t m_epgStoreEnd;
+  int64_t m_epgStoreTime;
+  PLATFORM::CMutex m_epgMutex;
+
   PLATFORM::CMutex m_mutex;
   PLATFORM::CCondition<bool> m_started;
 };
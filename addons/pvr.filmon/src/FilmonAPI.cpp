@@ -21,6 +21,8 @@
 #define CRYPTOPP_ENABLE_NAMESPACE_WEAK 1
 
 #include <algorithm>
+#include <deque>
+#include <map>
 #include <string>
 #include <cstdio>
 #include <sstream>
@@ -32,8 +34,15 @@
 
 #include <unistd.h>
 
+#include "platform/threads/mutex.h"
+#include "platform/util/timeutils.h"
+
+#include "client.h"
 #include "FilmonAPI.h"
 
+using namespace ADDON;
+using namespace PLATFORM;
+
 #define FILMON_URL "http://www.filmon.com/"
 #define FILMON_ONE_HOUR_RECORDING_SIZE 508831234
 #define USER_AGENT "AppleCoreMedia/1.0.0.8F455 (AppleTV; U; CPU OS 4_3 like Mac OS X; de_de)"
@@ -42,8 +51,10 @@
 #define REQUEST_CONNECTION_TIMEOUT 30 // 30s
 #define REQUEST_RETRIES 4
 #define REQUEST_RETRY_TIMEOUT 500000 // 0.5s
-#define RESPONSE_OUTPUT_LENGTH 128
+#define RESPONSE_INITIAL_SIZE 4096 // Grown by doubling
 #define DNS_CACHE_TIME -1 // Forever
+#define BATCH_CONNECTIONS 4 // Concurrent channel requests
+#define BATCH_WAIT_TIMEOUT 1000 // 1s
 
 #define RECORDED_STATUS "Recorded"
 #define TIMER_STATUS "Accepted"
@@ -76,7 +87,6 @@ static genreEntry genreTable[] = {
 
 #define GENRE_TABLE_LEN sizeof(genreTable)/sizeof(genreTable[0])
 
-bool filmonRequest(std::string path, std::string params = "");
 bool filmonAPIgetRecordingsTimers(bool completed = false);
 
 std::string filmonUsername = "";
@@ -92,15 +102,41 @@ std::vector<FILMON_CHANNEL_GROUP> groups;
 std::vector<FILMON_RECORDING> recordings;
 std::vector<FILMON_TIMER> timers;
 
-CURL *curl = NULL;
-CURLcode curlResult;
 bool curlConnected = false;
 
+// Idle curl handles, a request takes one so it keeps its connection alive
+// for the next request while requests on other threads get their own
+CMutex curlMutex;
+std::vector<CURL *> curlHandles;
+
+// Request totals, logged when the connection is deleted
+unsigned int requestCount = 0;
+unsigned int requestFailures = 0;
+long long requestBytes = 0;
+int64_t requestTime = 0;
+
 struct responseType {
 	char *memory;
 	size_t size;
+	size_t capacity;
+};
+
+// A request to the Filmon API and its response. The response buffer is
+// owned by the request, grows geometrically and is reused across retries
+class FilmonRequest {
+public:
+	FilmonRequest(void);
+	~FilmonRequest(void);
+
+	bool Perform(std::string path, std::string params = "");
+	bool Parse(Json::Value &root);
+	bool ParseChannel(unsigned int channelId, FILMON_CHANNEL *channel);
+	const char *Data(void) { return response.memory; }
+	size_t Size(void) { return response.size; }
+
+private:
+	struct responseType response;
 };
-struct responseType response;
 
 void toLowerCase(std::string &str) {
 	const int length = str.length();
@@ -137,16 +173,41 @@ void setTimerDefaults(FILMON_TIMER *t) {
 	t->iMarginEnd = 0;
 }
 
+// Empty the response, keeping its buffer
+static void clearResponse(struct responseType *mem) {
+	mem->size = 0;
+	if (mem->memory) {
+		mem->memory[0] = 0;
+	}
+}
+
+// Free the response buffer
+static void freeResponse(struct responseType *mem) {
+	free(mem->memory);
+	mem->memory = NULL;
+	mem->size = 0;
+	mem->capacity = 0;
+}
+
 // Libcurl response is memory
 static size_t getResponse(void *contents, size_t size, size_t nmemb,
 		void *userp) {
 	size_t realsize = size * nmemb;
 	struct responseType *mem = (struct responseType *) userp;
 
-	mem->memory = (char*) (realloc(mem->memory, mem->size + realsize + 1));
-	if (mem->memory == NULL) {
-		std::cerr << "FilmonAPI: not enough memory for response" << std::endl;
-		return 0;
+	if (mem->size + realsize + 1 > mem->capacity) {
+		size_t capacity = mem->capacity > 0 ?
+				mem->capacity : RESPONSE_INITIAL_SIZE;
+		while (capacity < mem->size + realsize + 1) {
+			capacity *= 2;
+		}
+		char *memory = (char*) (realloc(mem->memory, capacity));
+		if (memory == NULL) {
+			XBMC->Log(LOG_ERROR, "FilmonAPI: not enough memory for response");
+			return 0;
+		}
+		mem->memory = memory;
+		mem->capacity = capacity;
 	}
 
 	memcpy(&(mem->memory[mem->size]), contents, realsize);
@@ -156,62 +217,88 @@ static size_t getResponse(void *contents, size_t size, size_t nmemb,
 	return realsize;
 }
 
-// Free libcurl response
-void clearResponse() {
-	if (response.memory) {
-		free(response.memory);
-		std::cerr << "FilmonAPI: cleared response" << std::endl;
+// Take an idle handle, or create one
+static CURL *acquireHandle(void) {
+	{
+		CLockObject lock(curlMutex);
+		if (!curlHandles.empty()) {
+			CURL *handle = curlHandles.back();
+			curlHandles.pop_back();
+			return handle;
+		}
 	}
+	CURL *handle = curl_easy_init();
+	if (handle != NULL) {
+		curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, DNS_CACHE_TIME);
+		curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT,
+				REQUEST_CONNECTION_TIMEOUT);
+		curl_easy_setopt(handle, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
+		curl_easy_setopt(handle, CURLOPT_USERAGENT, USER_AGENT);
+		curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, getResponse);
+		curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: connection created");
+	}
+	return handle;
+}
+
+// Return a handle for reuse, a handle that failed is dropped so the next
+// request starts on a new connection
+static void releaseHandle(CURL *handle, bool reuse) {
+	if (handle == NULL) {
+		return;
+	}
+	if (reuse) {
+		CLockObject lock(curlMutex);
+		if (curlConnected) {
+			curlHandles.push_back(handle);
+			return;
+		}
+	}
+	curl_easy_cleanup(handle);
 }
 
 // Initialize connection
 bool filmonAPICreate(void) {
-	if (curl == NULL || curlConnected == false) {
-		curl_global_init (CURL_GLOBAL_ALL);
-		curl = curl_easy_init();
-		if (curl != NULL) {
-			curl = curl_easy_init();
-			curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, DNS_CACHE_TIME);
-			curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT,
-					REQUEST_CONNECTION_TIMEOUT);
-			curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-			curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
-			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, getResponse);
-			curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &response);
-			std::cerr << "FilmonAPI: connection created" << std::endl;
-			curlConnected = true;
-		}
-	} else {
-		curlConnected = true;
+	CLockObject lock(curlMutex);
+	if (curlConnected == false) {
+		curlConnected = curl_global_init(CURL_GLOBAL_ALL) == CURLE_OK;
 	}
 	return curlConnected;
 }
 
 // Remove connection
 void filmonAPIDelete(void) {
+	CLockObject lock(curlMutex);
 	if (curlConnected) {
-		curl_easy_cleanup(curl);
+		for (unsigned int i = 0; i < curlHandles.size(); i++) {
+			curl_easy_cleanup(curlHandles[i]);
+		}
+		curlHandles.clear();
 		curl_global_cleanup();
 		curlConnected = false;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: connection deleted, %u requests "
+				"(%u failed), %lld bytes, %lld ms", requestCount,
+				requestFailures, requestBytes, requestTime);
 	}
-	std::cerr << "FilmonAPI: connection deleted" << std::endl;
 }
 
-// Connection URL
-std::string filmonAPIConnection() {
-	if (curlConnected) {
-		return std::string(FILMON_URL);
-	} else {
-		return std::string(OFF_AIR);
-	}
+FilmonRequest::FilmonRequest(void) {
+	response.memory = NULL;
+	response.size = 0;
+	response.capacity = 0;
+}
+
+FilmonRequest::~FilmonRequest(void) {
+	freeResponse(&response);
 }
 
-// Make a request
-bool filmonRequest(std::string path, std::string params) {
-	curlResult = CURLE_OK;
+// Make a request, retrying on failure
+bool FilmonRequest::Perform(std::string path, std::string params) {
+	CURLcode curlResult = CURLE_OK;
 	std::string request = FILMON_URL;
-	int retries = REQUEST_RETRIES;
+	int attempts = 0;
 	long http_code = 0;
+	int64_t startTime = GetTimeMs();
 
 	// Add params
 	request.append(path);
@@ -220,75 +307,99 @@ bool filmonRequest(std::string path, std::string params) {
 		request.append(params);
 	}
 
+	CURL *handle = acquireHandle();
+	if (handle == NULL) {
+		XBMC->Log(LOG_ERROR, "FilmonAPI: no connection for %s", path.c_str());
+		return false;
+	}
+	curl_easy_setopt(handle, CURLOPT_URL, request.c_str());
+	curl_easy_setopt(handle, CURLOPT_WRITEDATA, (void *) &response);
+
 	// Allow request retries
 	do {
-		std::cerr << "FilmonAPI: request is '" << request << "'" << std::endl;
-
-		response.memory = (char*) (malloc(1));
-		response.size = 0;
-
-		if (curl) {
-			curl_easy_setopt(curl, CURLOPT_URL, request.c_str());
-			curlResult = curl_easy_perform(curl);
-			if (curlResult == CURLE_OK) {
-				curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-			}
+		if (attempts++ > 0) {
+			usleep(REQUEST_RETRY_TIMEOUT);
+		}
+		clearResponse(&response);
+		http_code = 0;
+		curlResult = curl_easy_perform(handle);
+		if (curlResult == CURLE_OK) {
+			curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_code);
 		}
-		std::cerr << "FilmonAPI: response is "
-				<< std::string(response.memory).substr(0,
-						RESPONSE_OUTPUT_LENGTH) << std::endl;
 		if (curlResult != CURLE_OK || http_code != 200) {
-			std::cerr << "FilmonAPI: request failure with HTTP code "
-					<< http_code << std::endl;
-			clearResponse();
-			usleep(REQUEST_RETRY_TIMEOUT);
+			XBMC->Log(LOG_ERROR, "FilmonAPI: %s failed with HTTP code %ld (%s)",
+					path.c_str(), http_code, curl_easy_strerror(curlResult));
 		}
-	} while (http_code != 200 && --retries > 0);
+	} while (http_code != 200 && attempts < REQUEST_RETRIES);
+
+	bool res = curlResult == CURLE_OK && http_code == 200;
+	releaseHandle(handle, res);
+
+	int64_t elapsed = GetTimeMs() - startTime;
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: %s returned %u bytes in %d ms (%d attempts)",
+			path.c_str(), (unsigned int) response.size, (int) elapsed, attempts);
+	{
+		CLockObject lock(curlMutex);
+		requestCount++;
+		if (!res) {
+			requestFailures++;
+		}
+		requestBytes += response.size;
+		requestTime += elapsed;
+	}
+	return res;
+}
 
-	if (curlResult == CURLE_OK && http_code == 200) {
-		return true;
-	} else {
-		filmonAPIDelete();
-		filmonAPICreate();
+// Parse a JSON response
+bool FilmonRequest::Parse(Json::Value &root) {
+	Json::Reader reader;
+	if (response.size == 0
+			|| !reader.parse(response.memory, response.memory + response.size,
+					root)) {
+		XBMC->Log(LOG_ERROR, "FilmonAPI: failed to parse response");
 		return false;
 	}
+	return true;
+}
+
+// Connection URL
+std::string filmonAPIConnection() {
+	if (curlConnected) {
+		return std::string(FILMON_URL);
+	} else {
+		return std::string(OFF_AIR);
+	}
 }
 
 // Logout user
 void filmonAPIlogout(void) {
-	bool res = filmonRequest("tv/api/logout");
-	if (res == true) {
-		clearResponse();
-	}
+	FilmonRequest request;
+	request.Perform("tv/api/logout");
 }
 
 // Keepalive
 bool filmonAPIkeepAlive(void) {
-	bool res = filmonRequest("tv/api/keep-alive", sessionKeyParam);
+	FilmonRequest request;
+	bool res = request.Perform("tv/api/keep-alive", sessionKeyParam);
 	if (!res) {
 		// Login again if it failed
 		filmonAPIlogout();
 		filmonAPIlogin(filmonUsername, filmonpassword);
-	} else {
-		clearResponse();
 	}
 	return res;
 }
 
 // Session
 bool filmonAPIgetSessionKey(void) {
-	bool res = filmonRequest("tv/api/init?channelProvider=ipad&app_id=IGlsbSBuVCJ7UDwZBl0eBR4JGgEBERhRXlBcWl0CEw==");
+	FilmonRequest request;
+	bool res = request.Perform("tv/api/init?channelProvider=ipad&app_id=IGlsbSBuVCJ7UDwZBl0eBR4JGgEBERhRXlBcWl0CEw==");
 	if (res == true) {
 		Json::Value root;
-		Json::Reader reader;
-		reader.parse(&response.memory[0],
-				&response.memory[(long) response.size - 1], root);
+		request.Parse(root);
 		Json::Value sessionKey = root["session_key"];
 		sessionKeyParam = "session_key=";
 		sessionKeyParam.append(sessionKey.asString());
-		std::cerr << "FilmonAPI: got session key '" << sessionKey.asString()
-						<< "'" << std::endl;
-		clearResponse();
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: got session key");
 	}
 	return res;
 }
@@ -298,7 +409,7 @@ bool filmonAPIlogin(std::string username, std::string password) {
 
 	bool res = filmonAPIgetSessionKey();
 	if (res) {
-		std::cerr << "FilmonAPI: logging in user" << std::endl;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: logging in user");
 		filmonUsername = username;
 		filmonpassword = password;
 		// Password is MD5 hex
@@ -313,12 +424,11 @@ bool filmonAPIlogin(std::string username, std::string password) {
 		encoder.MessageEnd();
 		toLowerCase(md5pwd);
 		std::string params = "login=" + username + "&password=" + md5pwd;
-		res = filmonRequest("tv/api/login", sessionKeyParam + "&" + params);
+		FilmonRequest request;
+		res = request.Perform("tv/api/login", sessionKeyParam + "&" + params);
 		if (res) {
 			Json::Value root;
-			Json::Reader reader;
-			reader.parse(&response.memory[0],
-					&response.memory[(long) response.size - 1], root);
+			request.Parse(root);
 			// Favorite channels
 			channelList.clear();
 			Json::Value favouriteChannels = root["favorite-channels"];
@@ -326,10 +436,9 @@ bool filmonAPIlogin(std::string username, std::string password) {
 			for (unsigned int channel = 0; channel < channelCount; channel++) {
 				Json::Value chId = favouriteChannels[channel]["channel"]["id"];
 				channelList.push_back(chId.asUInt());
-				std::cerr << "FilmonAPI: added channel " << chId.asUInt()
-								<< std::endl;
+				XBMC->Log(LOG_DEBUG, "FilmonAPI: added channel %u",
+						chId.asUInt());
 			}
-			clearResponse();
 		}
 	}
 	return res;
@@ -339,11 +448,13 @@ bool filmonAPIlogin(std::string username, std::string password) {
 void filmonAPIgetswfPlayer() {
 	swfPlayer = std::string(
 			"/tv/modules/FilmOnTV/files/flashapp/filmon/FilmonPlayer.swf?v=56");
-	bool res = filmonRequest("tv/", "");
+	FilmonRequest request;
+	bool res = request.Perform("tv/", "");
 	if (res == true) {
-		char *resp = (char *) malloc(response.size);
-		strcpy(resp, response.memory);
-		char *token = strtok(resp, " ");
+		std::vector<char> resp(request.Data(),
+				request.Data() + request.Size());
+		resp.push_back('\0');
+		char *token = strtok(&resp[0], " ");
 		while (token != NULL) {
 			if (strcmp(token, "flash_config") == 0) {
 				token = strtok(NULL, " ");
@@ -354,16 +465,15 @@ void filmonAPIgetswfPlayer() {
 		}
 		Json::Value root;
 		Json::Reader reader;
-		if (reader.parse(std::string(token), root)) {
+		if (token != NULL && reader.parse(std::string(token), root)) {
 			Json::Value streamer = root["streamer"];
 			swfPlayer = streamer.asString();
-			std::cerr << "FilmonAPI: parsed flash config " << swfPlayer
-					<< std::endl;
+			XBMC->Log(LOG_DEBUG, "FilmonAPI: parsed flash config %s",
+					swfPlayer.c_str());
 		}
-		clearResponse();
 	}
 	swfPlayer = std::string("http://www.filmon.com") + swfPlayer;
-	std::cerr << "FilmonAPI: swfPlayer is " << swfPlayer << std::endl;
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: swfPlayer is %s", swfPlayer.c_str());
 }
 
 int filmonAPIgetGenre(std::string group) {
@@ -394,132 +504,298 @@ std::string filmonAPIgetRtmpStream(std::string url, std::string name) {
 				+ " live=1 timeout=10 swfVfy=1";
 		return streamUrl;
 	} else {
-		std::cerr << "FilmonAPI: no stream available" << std::endl;
+		XBMC->Log(LOG_ERROR, "FilmonAPI: no stream available");
 		return std::string("");
 	}
 }
 
-// Channel
-bool filmonAPIgetChannel(unsigned int channelId, FILMON_CHANNEL *channel) {
-	bool res = filmonRequest("tv/api/channel/" + intToString(channelId),
-			sessionKeyParam);
-	if (res == true) {
-		Json::Value root;
-		Json::Reader reader;
-		reader.parse(&response.memory[0],
-				&response.memory[(long) response.size - 1], root);
-		Json::Value title = root["title"];
-		Json::Value group = root["group"];
-		Json::Value icon = root["extra_big_logo"];
-		Json::Value streams = root["streams"];
-		Json::Value tvguide = root["tvguide"];
-		std::string streamURL;
-		unsigned int streamCount = streams.size();
-		unsigned int stream = 0;
-		for (stream = 0; stream < streamCount; stream++) {
-			std::string quality = streams[stream]["quality"].asString();
-			if (quality.compare(std::string("high")) == 0 || quality.compare(std::string("480p")) == 0 || quality.compare(std::string("HD")) == 0) {
-				std::cerr << "FilmonAPI: high quality stream found: " << quality << std::endl;
-				break;
+// Parse a channel response into channel details and guide
+static bool filmonAPIparseChannel(unsigned int channelId,
+		struct responseType *resp, FILMON_CHANNEL *channel) {
+	Json::Value root;
+	Json::Reader reader;
+	if (resp->size == 0
+			|| reader.parse(resp->memory, resp->memory + resp->size, root)
+					== false || root.isObject() == false) {
+		XBMC->Log(LOG_ERROR, "FilmonAPI: failed to parse channel %u",
+				channelId);
+		return false;
+	}
+	Json::Value title = root["title"];
+	Json::Value group = root["group"];
+	Json::Value icon = root["extra_big_logo"];
+	Json::Value streams = root["streams"];
+	Json::Value tvguide = root["tvguide"];
+	std::string streamURL;
+	unsigned int streamCount = streams.size();
+	unsigned int stream = 0;
+	for (stream = 0; stream < streamCount; stream++) {
+		std::string quality = streams[stream]["quality"].asString();
+		if (quality.compare(std::string("high")) == 0 || quality.compare(std::string("480p")) == 0 || quality.compare(std::string("HD")) == 0) {
+			XBMC->Log(LOG_DEBUG, "FilmonAPI: high quality stream found: %s",
+					quality.c_str());
+			break;
+		} else {
+			XBMC->Log(LOG_DEBUG, "FilmonAPI: low quality stream found: %s",
+					quality.c_str());
+		}
+	}
+	std::string chTitle = title.asString();
+	std::string iconPath = icon.asString();
+	streamURL = streams[stream]["url"].asString();
+	if (streamURL.find("rtmp://") == 0) {
+		streamURL = filmonAPIgetRtmpStream(streamURL, streams[stream]["name"].asString());
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: RTMP stream available: %s",
+				streamURL.c_str());
+	} else {
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: HLS stream available: %s",
+				streamURL.c_str());
+	}
+
+	// Fix channel names logos
+	if (chTitle.compare(std::string("CBEEBIES/BBC Four")) == 0) {
+		chTitle = std::string("BBC Four/CBEEBIES");
+		iconPath =
+				std::string(
+						"https://dl.dropboxusercontent.com/u/3129606/tvicons/BBC%20FOUR.png");
+	}
+	if (chTitle.compare(std::string("CBBC/BBC Three")) == 0) {
+		chTitle = std::string("BBC Three/CBBC");
+		iconPath =
+				std::string(
+						"https://dl.dropboxusercontent.com/u/3129606/tvicons/BBC%20THREE.png");
+	}
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: title is %s", chTitle.c_str());
+
+	channel->bRadio = false;
+	channel->iUniqueId = channelId;
+	channel->iChannelNumber = channelId;
+	channel->iEncryptionSystem = 0;
+	channel->strChannelName = chTitle;
+	channel->strIconPath = iconPath;
+	channel->strStreamURL = streamURL;
+	(channel->epg).clear();
+
+	// Get EPG
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: building EPG");
+	unsigned int entries = 0;
+	unsigned int programmeCount = tvguide.size();
+	std::string offAir = std::string("OFF_AIR");
+	for (unsigned int p = 0; p < programmeCount; p++) {
+		Json::Value broadcastId = tvguide[p]["programme"];
+		std::string programmeId = broadcastId.asString();
+		Json::Value startTime = tvguide[p]["startdatetime"];
+		Json::Value endTime = tvguide[p]["enddatetime"];
+		Json::Value programmeName = tvguide[p]["programme_name"];
+		Json::Value plot = tvguide[p]["programme_description"];
+		Json::Value images = tvguide[p]["images"];
+		FILMON_EPG_ENTRY epgEntry;
+		if (programmeId.compare(offAir) != 0) {
+			epgEntry.strTitle = programmeName.asString();
+			epgEntry.iBroadcastId = stringToInt(programmeId);
+			if (plot.isNull() != true) {
+				epgEntry.strPlot = plot.asString();
+			}
+			if (!images.empty()) {
+				Json::Value programmeIcon = images[0]["url"];
+				epgEntry.strIconPath = programmeIcon.asString();
 			} else {
-				std::cerr << "FilmonAPI: low quality stream found: " << quality << std::endl;
+				epgEntry.strIconPath = "";
 			}
+		} else {
+			epgEntry.strTitle = offAir;
+			epgEntry.iBroadcastId = 0;
+			epgEntry.strPlot = "";
+			epgEntry.strIconPath = "";
 		}
-		std::string chTitle = title.asString();
-		std::string iconPath = icon.asString();
-		streamURL = streams[stream]["url"].asString();
-		if (streamURL.find("rtmp://") == 0) {
-			streamURL = filmonAPIgetRtmpStream(streamURL, streams[stream]["name"].asString());
-			std::cerr << "FilmonAPI: RTMP stream available: " << streamURL << std::endl;
+		epgEntry.iChannelId = channelId;
+		if (startTime.isString()) {
+			epgEntry.startTime = stringToInt(startTime.asString());
+			epgEntry.endTime = stringToInt(endTime.asString());
 		} else {
-			std::cerr << "FilmonAPI: HLS stream available: " << streamURL << std::endl;
+			epgEntry.startTime = startTime.asUInt();
+			epgEntry.endTime = endTime.asUInt();
+		}
+		epgEntry.strPlotOutline = "";
+		epgEntry.iGenreType = filmonAPIgetGenre(group.asString());
+		epgEntry.iGenreSubType = 0;
+		(channel->epg).push_back(epgEntry);
+		entries++;
+	}
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: number of EPG entries is %u", entries);
+	return true;
+}
+
+bool FilmonRequest::ParseChannel(unsigned int channelId,
+		FILMON_CHANNEL *channel) {
+	return filmonAPIparseChannel(channelId, &response, channel);
+}
+
+// Channel
+bool filmonAPIgetChannel(unsigned int channelId, FILMON_CHANNEL *channel) {
+	FilmonRequest request;
+	bool res = request.Perform("tv/api/channel/" + intToString(channelId),
+			sessionKeyParam);
+	if (res == true) {
+		res = request.ParseChannel(channelId, channel);
+	}
+	return res;
+}
+
+// Channels, fetched concurrently over at most BATCH_CONNECTIONS connections.
+// Returns true if every channel was fetched, channels holds those that were
+// in the order they were requested
+bool filmonAPIgetChannelsBatch(std::vector<unsigned int> channelIds,
+		std::vector<FILMON_CHANNEL> &channels) {
+	unsigned int channelCount = channelIds.size();
+	std::vector<FILMON_CHANNEL> results(channelCount);
+	std::vector<bool> fetched(channelCount, false);
+	std::vector<int> retries(channelCount, REQUEST_RETRIES);
+	std::deque<unsigned int> pending;
+	std::map<CURL *, unsigned int> active;
+	struct responseType responses[BATCH_CONNECTIONS];
+	CURL *handles[BATCH_CONNECTIONS];
+	bool reuse[BATCH_CONNECTIONS];
+	std::vector<unsigned int> idle;
+	int64_t startTime = GetTimeMs();
+	long long bytes = 0;
+	unsigned int requests = 0;
+	unsigned int failures = 0;
+
+	channels.clear();
+	if (channelCount == 0) {
+		return true;
+	}
+
+	// RTMP stream URLs need the player, get it before the batch starts
+	if (swfPlayer.empty()) {
+		filmonAPIgetswfPlayer();
+	}
+
+	CURLM *multi = curl_multi_init();
+	if (multi == NULL) {
+		return false;
+	}
+	for (unsigned int i = 0; i < BATCH_CONNECTIONS; i++) {
+		responses[i].memory = NULL;
+		responses[i].size = 0;
+		responses[i].capacity = 0;
+		reuse[i] = true;
+		handles[i] = acquireHandle();
+		if (handles[i] != NULL) {
+			curl_easy_setopt(handles[i], CURLOPT_WRITEDATA,
+					(void *) &responses[i]);
+			idle.push_back(i);
 		}
+	}
+	for (unsigned int i = 0; i < channelCount; i++) {
+		pending.push_back(i);
+	}
 
-		// Fix channel names logos
-		if (chTitle.compare(std::string("CBEEBIES/BBC Four")) == 0) {
-			chTitle = std::string("BBC Four/CBEEBIES");
-			iconPath =
-					std::string(
-							"https://dl.dropboxusercontent.com/u/3129606/tvicons/BBC%20FOUR.png");
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: fetching %u channels over %u connections",
+			channelCount, (unsigned int) idle.size());
+
+	int running = 0;
+	while (!pending.empty() || !active.empty()) {
+		// Hand out requests to idle connections
+		while (!pending.empty() && !idle.empty()) {
+			unsigned int i = pending.front();
+			pending.pop_front();
+			unsigned int slot = idle.back();
+			idle.pop_back();
+
+			clearResponse(&responses[slot]);
+			std::string request = std::string(FILMON_URL) + "tv/api/channel/"
+					+ intToString(channelIds[i]) + "?" + sessionKeyParam;
+			curl_easy_setopt(handles[slot], CURLOPT_URL, request.c_str());
+			curl_multi_add_handle(multi, handles[slot]);
+			active[handles[slot]] = i;
 		}
-		if (chTitle.compare(std::string("CBBC/BBC Three")) == 0) {
-			chTitle = std::string("BBC Three/CBBC");
-			iconPath =
-					std::string(
-							"https://dl.dropboxusercontent.com/u/3129606/tvicons/BBC%20THREE.png");
+		if (active.empty()) {
+			break;
 		}
-		std::cerr << "FilmonAPI: title is " << chTitle << std::endl;
-
-		channel->bRadio = false;
-		channel->iUniqueId = channelId;
-		channel->iChannelNumber = channelId;
-		channel->iEncryptionSystem = 0;
-		channel->strChannelName = chTitle;
-		channel->strIconPath = iconPath;
-		channel->strStreamURL = streamURL;
-		(channel->epg).clear();
-
-		// Get EPG
-		std::cerr << "FilmonAPI: building EPG" << std::endl;
-		unsigned int entries = 0;
-		unsigned int programmeCount = tvguide.size();
-		std::string offAir = std::string("OFF_AIR");
-		for (unsigned int p = 0; p < programmeCount; p++) {
-			Json::Value broadcastId = tvguide[p]["programme"];
-			std::string programmeId = broadcastId.asString();
-			Json::Value startTime = tvguide[p]["startdatetime"];
-			Json::Value endTime = tvguide[p]["enddatetime"];
-			Json::Value programmeName = tvguide[p]["programme_name"];
-			Json::Value plot = tvguide[p]["programme_description"];
-			Json::Value images = tvguide[p]["images"];
-			FILMON_EPG_ENTRY epgEntry;
-			if (programmeId.compare(offAir) != 0) {
-				epgEntry.strTitle = programmeName.asString();
-				epgEntry.iBroadcastId = stringToInt(programmeId);
-				if (plot.isNull() != true) {
-					epgEntry.strPlot = plot.asString();
-				}
-				if (!images.empty()) {
-					Json::Value programmeIcon = images[0]["url"];
-					epgEntry.strIconPath = programmeIcon.asString();
-				} else {
-					epgEntry.strIconPath = "";
-				}
-			} else {
-				epgEntry.strTitle = offAir;
-				epgEntry.iBroadcastId = 0;
-				epgEntry.strPlot = "";
-				epgEntry.strIconPath = "";
+
+		curl_multi_perform(multi, &running);
+
+		// Collect finished requests, failures go to the back of the queue
+		CURLMsg *msg = NULL;
+		int queued = 0;
+		while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			CURL *handle = msg->easy_handle;
+			CURLcode result = msg->data.result;
+			unsigned int i = active[handle];
+			unsigned int slot = 0;
+			long http_code = 0;
+
+			while (handles[slot] != handle) {
+				slot++;
 			}
-			epgEntry.iChannelId = channelId;
-			if (startTime.isString()) {
-				epgEntry.startTime = stringToInt(startTime.asString());
-				epgEntry.endTime = stringToInt(endTime.asString());
+			curl_multi_remove_handle(multi, handle);
+			active.erase(handle);
+			idle.push_back(slot);
+
+			if (result == CURLE_OK) {
+				curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_code);
+			}
+			requests++;
+			bytes += responses[slot].size;
+			reuse[slot] = result == CURLE_OK && http_code == 200;
+			if (reuse[slot]) {
+				fetched[i] = filmonAPIparseChannel(channelIds[i],
+						&responses[slot], &results[i]);
 			} else {
-				epgEntry.startTime = startTime.asUInt();
-				epgEntry.endTime = endTime.asUInt();
+				failures++;
+				XBMC->Log(LOG_ERROR, "FilmonAPI: channel %u failed with HTTP "
+						"code %ld (%s)", channelIds[i], http_code,
+						curl_easy_strerror(result));
+				if (--retries[i] > 0) {
+					pending.push_back(i);
+				}
 			}
-			epgEntry.strPlotOutline = "";
-			epgEntry.iGenreType = filmonAPIgetGenre(group.asString());
-			epgEntry.iGenreSubType = 0;
-			(channel->epg).push_back(epgEntry);
-			entries++;
 		}
-		std::cerr << "FilmonAPI: number of EPG entries is " << entries
-				<< std::endl;
-		clearResponse();
+
+		if (running > 0) {
+			int numfds = 0;
+			curl_multi_wait(multi, NULL, 0, BATCH_WAIT_TIMEOUT, &numfds);
+		}
 	}
-	return res;
+
+	curl_multi_cleanup(multi);
+	for (unsigned int i = 0; i < BATCH_CONNECTIONS; i++) {
+		releaseHandle(handles[i], reuse[i]);
+		freeResponse(&responses[i]);
+	}
+
+	for (unsigned int i = 0; i < channelCount; i++) {
+		if (fetched[i]) {
+			channels.push_back(results[i]);
+		}
+	}
+
+	int64_t elapsed = GetTimeMs() - startTime;
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: fetched %u of %u channels, %lld bytes "
+			"in %d ms (%u requests)", (unsigned int) channels.size(),
+			channelCount, bytes, (int) elapsed, requests);
+	{
+		CLockObject lock(curlMutex);
+		requestCount += requests;
+		requestFailures += failures;
+		requestBytes += bytes;
+		requestTime += elapsed;
+	}
+	return channels.size() == channelCount;
 }
 
 // Channel groups
 std::vector<FILMON_CHANNEL_GROUP> filmonAPIgetChannelGroups() {
-	bool res = filmonRequest("tv/api/groups", sessionKeyParam);
+	FilmonRequest request;
+	bool res = request.Perform("tv/api/groups", sessionKeyParam);
 	if (res == true) {
 		Json::Value root;
-		Json::Reader reader;
-		reader.parse(&response.memory[0],
-				&response.memory[(long) response.size - 1], root);
+		request.Parse(root);
 		for (unsigned int i = 0; i < root.size(); i++) {
 			Json::Value groupName = root[i]["group"];
 			Json::Value groupId = root[i]["group_id"];
@@ -536,18 +812,17 @@ std::vector<FILMON_CHANNEL_GROUP> filmonAPIgetChannelGroups() {
 				if (std::find(channelList.begin(), channelList.end(), ch)
 				!= channelList.end()) {
 					members.push_back(ch);
-					std::cerr << "FilmonAPI: added channel " << ch
-							<< " to group " << group.strGroupName << std::endl;
+					XBMC->Log(LOG_DEBUG, "FilmonAPI: added channel %u to group %s",
+							ch, group.strGroupName.c_str());
 				}
 			}
 			if (members.size() > 0) {
 				group.members = members;
 				groups.push_back(group);
-				std::cerr << "FilmonAPI: added group " << group.strGroupName
-						<< std::endl;
+				XBMC->Log(LOG_DEBUG, "FilmonAPI: added group %s",
+						group.strGroupName.c_str());
 			}
 		}
-		clearResponse();
 	}
 	return groups;
 }
@@ -567,22 +842,20 @@ unsigned int filmonAPIgetChannelCount(void) {
 
 // Gets all timers and recordings
 bool filmonAPIgetRecordingsTimers(bool completed) {
-	bool res = filmonRequest("tv/api/dvr/list", sessionKeyParam);
+	FilmonRequest request;
+	bool res = request.Perform("tv/api/dvr/list", sessionKeyParam);
 	if (res == true) {
 		Json::Value root;
-		Json::Reader reader;
-		reader.parse(&response.memory[0],
-				&response.memory[(long) response.size - 1], root);
+		request.Parse(root);
 
 		// Usage
 		Json::Value total = root["userStorage"]["total"];
 		Json::Value used = root["userStorage"]["recorded"];
 		storageTotal = (long long int) (total.asFloat() * FILMON_ONE_HOUR_RECORDING_SIZE); // bytes
 		storageUsed = (long long int) (used.asFloat() * FILMON_ONE_HOUR_RECORDING_SIZE); // bytes
-		std::cerr << "FilmonAPI: recordings total is " << storageTotal
-				<< std::endl;
-		std::cerr << "FilmonAPI: recordings used is " << storageUsed
-				<< std::endl;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: recordings total is %lld",
+				storageTotal);
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: recordings used is %lld", storageUsed);
 
 		bool timersCleared = false;
 		bool recordingsCleared = false;
@@ -617,8 +890,8 @@ bool filmonAPIgetRecordingsTimers(bool completed) {
 				recording.strIconPath =	recordingsTimers[recordingId]["images"]["channel_logo"].asString();
 				recording.strThumbnailPath = recordingsTimers[recordingId]["images"]["poster"].asString();
 				recordings.push_back(recording);
-				std::cerr << "FilmonAPI: found completed recording "
-						<< recording.strTitle << std::endl;
+				XBMC->Log(LOG_DEBUG, "FilmonAPI: found completed recording %s",
+						recording.strTitle.c_str());
 			} else if (status.asString().compare(std::string(TIMER_STATUS))
 					== 0) {
 				if (timersCleared == false) {
@@ -639,22 +912,21 @@ bool filmonAPIgetRecordingsTimers(bool completed) {
 				setTimerDefaults(&timer);
 				time_t t = time(0);
 				if (t >= timer.startTime && t <= timer.endTime) {
-					std::cerr << "FilmonAPI: found active timer "
-							<< timer.strTitle << std::endl;
+					XBMC->Log(LOG_DEBUG, "FilmonAPI: found active timer %s",
+							timer.strTitle.c_str());
 					timer.state = FILMON_TIMER_STATE_RECORDING;
 				} else if (t < timer.startTime) {
-					std::cerr << "FilmonAPI: found scheduled timer "
-							<< timer.strTitle << std::endl;
+					XBMC->Log(LOG_DEBUG, "FilmonAPI: found scheduled timer %s",
+							timer.strTitle.c_str());
 					timer.state = FILMON_TIMER_STATE_SCHEDULED;
 				} else if (t > timer.endTime) {
-					std::cerr << "FilmonAPI: found completed timer "
-							<< timer.strTitle << std::endl;
+					XBMC->Log(LOG_DEBUG, "FilmonAPI: found completed timer %s",
+							timer.strTitle.c_str());
 					timer.state = FILMON_TIMER_STATE_COMPLETED;
 				}
 				timers.push_back(timer);
 			}
 		}
-		clearResponse();
 	}
 	return res;
 }
@@ -663,7 +935,7 @@ bool filmonAPIgetRecordingsTimers(bool completed) {
 std::vector<FILMON_RECORDING> filmonAPIgetRecordings(void) {
 	bool completed = true;
 	if (filmonAPIgetRecordingsTimers(completed) != true) {
-		std::cerr << "FilmonAPI: failed to get recordings" << std::endl;
+		XBMC->Log(LOG_ERROR, "FilmonAPI: failed to get recordings");
 	}
 	return recordings;
 }
@@ -671,29 +943,30 @@ std::vector<FILMON_RECORDING> filmonAPIgetRecordings(void) {
 // Delete a recording
 bool filmonAPIdeleteRecording(unsigned int recordingId) {
 	bool res = false;
-	std::cerr << "FilmonAPI: number recordings is " << recordings.size() << std::endl;
+	XBMC->Log(LOG_DEBUG, "FilmonAPI: number recordings is %u",
+			(unsigned int) recordings.size());
 	for (unsigned int i = 0; i < recordings.size(); i++) {
-		std::cerr << "FilmonAPI: looking for recording " <<  intToString(recordingId) << std::endl;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: looking for recording %s",
+				intToString(recordingId).c_str());
 		if ((recordings[i].strRecordingId).compare(intToString(recordingId)) == 0) {
 			std::string params = "record_id=" + recordings[i].strRecordingId;
-			res = filmonRequest("tv/api/dvr/remove",
+			FilmonRequest request;
+			res = request.Perform("tv/api/dvr/remove",
 					sessionKeyParam + "&" + params);
 			if (res) {
 				Json::Value root;
-				Json::Reader reader;
-				reader.parse(&response.memory[0],
-						&response.memory[(long) response.size - 1], root);
+				request.Parse(root);
 				if (root["success"].asBool()) {
 					recordings.erase(recordings.begin() + i);
-					std::cerr << "FilmonAPI: deleted recording" << std::endl;
+					XBMC->Log(LOG_DEBUG, "FilmonAPI: deleted recording");
 				} else {
 					res = false;
 				}
-				clearResponse();
 			}
 			break;
 		}
-		std::cerr << "FilmonAPI: found recording " <<  recordings[i].strRecordingId << std::endl;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: found recording %s",
+				recordings[i].strRecordingId.c_str());
 	}
 	return res;
 }
@@ -701,20 +974,19 @@ bool filmonAPIdeleteRecording(unsigned int recordingId) {
 // Get timers
 std::vector<FILMON_TIMER> filmonAPIgetTimers(void) {
 	if (filmonAPIgetRecordingsTimers() != true) {
-		std::cerr << "FilmonAPI: failed to get timers" << std::endl;
+		XBMC->Log(LOG_ERROR, "FilmonAPI: failed to get timers");
 	}
 	return timers;
 }
 
 // Add a timer
 bool filmonAPIaddTimer(int channelId, time_t startTime, time_t endTime) {
-	bool res = filmonRequest("tv/api/tvguide/" + intToString(channelId),
+	FilmonRequest request;
+	bool res = request.Perform("tv/api/tvguide/" + intToString(channelId),
 			sessionKeyParam);
 	if (res) {
 		Json::Value root;
-		Json::Reader reader;
-		reader.parse(&response.memory[0],
-				&response.memory[(long) response.size - 1], root);
+		request.Parse(root);
 		for (unsigned int i = 0; i < root.size(); i++) {
 			Json::Value start = root[i]["startdatetime"];
 			Json::Value end = root[i]["enddatetime"];
@@ -738,13 +1010,12 @@ bool filmonAPIaddTimer(int channelId, time_t startTime, time_t endTime) {
 				std::string params = "channel_id=" + intToString(channelId)
 								+ "&programme_id=" + programmeId + "&start_time="
 								+ intToString(epgStartTime);
-				res = filmonRequest("tv/api/dvr/add",
+				FilmonRequest addRequest;
+				res = addRequest.Perform("tv/api/dvr/add",
 						sessionKeyParam + "&" + params);
 				if (res) {
 					Json::Value root;
-					Json::Reader reader;
-					reader.parse(&response.memory[0],
-							&response.memory[(long) response.size - 1], root);
+					addRequest.Parse(root);
 					if (root["success"].asBool()) {
 						FILMON_TIMER timer;
 						timer.iClientIndex = stringToInt(programmeId);
@@ -761,7 +1032,7 @@ bool filmonAPIaddTimer(int channelId, time_t startTime, time_t endTime) {
 						}
 						setTimerDefaults(&timer);
 						timers.push_back(timer);
-						std::cerr << "FilmonAPI: added timer" << std::endl;
+						XBMC->Log(LOG_DEBUG, "FilmonAPI: added timer");
 					} else {
 						res = false;
 					}
@@ -769,7 +1040,6 @@ bool filmonAPIaddTimer(int channelId, time_t startTime, time_t endTime) {
 				break;
 			}
 		}
-		clearResponse();
 	}
 	return res;
 }
@@ -778,32 +1048,30 @@ bool filmonAPIaddTimer(int channelId, time_t startTime, time_t endTime) {
 bool filmonAPIdeleteTimer(unsigned int timerId, bool bForceDelete) {
 	bool res = true;
 	for (unsigned int i = 0; i < timers.size(); i++) {
-		std::cerr << "FilmonAPI: looking for timer " <<  timerId << std::endl;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: looking for timer %u", timerId);
 		if (timers[i].iClientIndex == timerId) {
 			time_t t = time(0);
 			if ((t >= timers[i].startTime && t <= timers[i].endTime
 					&& bForceDelete) || t < timers[i].startTime
 					|| t > timers[i].endTime) {
 				std::string params = "record_id=" + intToString(timerId);
-				res = filmonRequest("tv/api/dvr/remove",
+				FilmonRequest request;
+				res = request.Perform("tv/api/dvr/remove",
 						sessionKeyParam + "&" + params);
 				if (res) {
 					Json::Value root;
-					Json::Reader reader;
-					reader.parse(&response.memory[0],
-							&response.memory[(long) response.size - 1], root);
+					request.Parse(root);
 					if (root["success"].asBool()) {
 						timers.erase(timers.begin() + i);
-						std::cerr << "FilmonAPI: deleted timer" << std::endl;
+						XBMC->Log(LOG_DEBUG, "FilmonAPI: deleted timer");
 					} else {
 						res = false;
 					}
-					clearResponse();
 				}
 			}
 			break;
 		}
-		std::cerr << "FilmonAPI: found timer " <<  timerId << std::endl;
+		XBMC->Log(LOG_DEBUG, "FilmonAPI: found timer %u", timerId);
 	}
 	return res;
 }
@@ -25,6 +25,9 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <map>
+
+#include <jsoncpp/json/json.h>
 
 using namespace std;
 using namespace ADDON;
@@ -32,9 +35,15 @@ using namespace ADDON;
 
 PVRFilmonData::PVRFilmonData(void) {
 	onLoad = true;
+	channelsFromCache = false;
+	lastTimeChannels = 0;
+	lastTimeGroups = 0;
 }
 
 PVRFilmonData::~PVRFilmonData(void) {
+	StopThread(-1);
+	m_refresh.Signal();
+	StopThread(0);
 	m_channels.clear();
 	m_groups.clear();
 	m_recordings.clear();
@@ -50,9 +59,16 @@ bool PVRFilmonData::Load(std::string user, std::string pwd) {
 	if (res) {
 		res = filmonAPIlogin(username, password);
 		if (res) {
+			{
+				PLATFORM::CLockObject channelLock(m_channelMutex);
+				m_channelIds = filmonAPIgetChannels();
+			}
 			XBMC->QueueNotification(QUEUE_INFO, "Filmon user logged in");
-			lastTimeChannels = 0;
 			lastTimeGroups = 0;
+			// Serve channels from the cache straight away and refresh them
+			// in the background
+			LoadChannelCache();
+			CreateThread(false);
 		} else {
 			XBMC->QueueNotification(QUEUE_ERROR, "Filmon user failed to login");
 		}
@@ -61,6 +77,227 @@ bool PVRFilmonData::Load(std::string user, std::string pwd) {
 	return res;
 }
 
+// Refreshes channels when they are stale or GetEPGForChannel asks for it
+void *PVRFilmonData::Process(void) {
+	while (!IsStopped()) {
+		if (ChannelsExpired()) {
+			RefreshChannels(true);
+		}
+		m_refresh.Wait(FILMON_REFRESH_CHECK);
+	}
+	return NULL;
+}
+
+bool PVRFilmonData::ChannelsExpired(void) {
+	PLATFORM::CLockObject lock(m_channelMutex);
+	return m_channels.empty() || channelsFromCache
+			|| time(0) - lastTimeChannels > FILMON_CACHE_TIME;
+}
+
+// Fetches all channels and their guide in one batch. The API lock is only
+// held for the requests, so channels can be served while this runs
+void PVRFilmonData::RefreshChannels(bool bBackground) {
+	std::vector<PVRFilmonChannel> channels;
+	std::vector<unsigned int> channelIds;
+	time_t cacheTime = 0;
+	bool complete = false;
+	bool relogin = false;
+	{
+		PLATFORM::CLockObject lock(m_mutex);
+		// Someone else may have refreshed while we waited
+		if (!ChannelsExpired()) {
+			return;
+		}
+		{
+			PLATFORM::CLockObject channelLock(m_channelMutex);
+			relogin = bBackground && !channelsFromCache && !m_channels.empty();
+		}
+		if (relogin) {
+			// Picks up changes to the favourite channels
+			if (!filmonAPIlogin(username, password)) {
+				XBMC->Log(LOG_ERROR, "failed to login to refresh channels");
+				return;
+			}
+			lastTimeGroups = 0;
+		}
+		XBMC->Log(LOG_DEBUG, "getting channels from API");
+		channelIds = filmonAPIgetChannels();
+		complete = filmonAPIgetChannelsBatch(channelIds, channels);
+	}
+	if (channels.empty()) {
+		XBMC->Log(LOG_ERROR, "failed to get channels from API");
+		return;
+	}
+
+	{
+		PLATFORM::CLockObject lock(m_channelMutex);
+		if (!complete) {
+			// Keep what we had for channels that failed this time
+			std::map<unsigned int, bool> fetched;
+			for (unsigned int i = 0; i < channels.size(); i++) {
+				fetched[channels[i].iUniqueId] = true;
+			}
+			for (unsigned int i = 0; i < m_channels.size(); i++) {
+				if (fetched.find(m_channels[i].iUniqueId) == fetched.end()) {
+					channels.push_back(m_channels[i]);
+				}
+			}
+		}
+		m_channels.swap(channels);
+		m_channelIds = channelIds;
+		lastTimeChannels = time(0);
+		channelsFromCache = false;
+		XBMC->Log(LOG_DEBUG, "refreshed %d channels", m_channels.size());
+		// Written from a copy, lookups don't wait for the disk
+		channels = m_channels;
+		cacheTime = lastTimeChannels;
+	}
+	SaveChannelCache(channels, cacheTime);
+
+	if (bBackground) {
+		// Get PVR to re-read refreshed channels
+		if (relogin) {
+			PVR->TriggerChannelGroupsUpdate();
+		}
+		PVR->TriggerChannelUpdate();
+		for (unsigned int i = 0; i < channelIds.size(); i++) {
+			PVR->TriggerEpgUpdate(channelIds[i]);
+		}
+	}
+}
+
+// Channel cache file, written after each refresh
+static std::string channelCachePath(void) {
+	std::string path = g_strUserPath;
+	if (!path.empty() && path[path.length() - 1] != '/'
+			&& path[path.length() - 1] != '\\') {
+		path += "/";
+	}
+	return path + FILMON_CACHE_FILE;
+}
+
+// Loads channels and guide saved by a previous session. Guide entries that
+// have already ended are dropped, the whole cache is dropped if it's too old
+// or belongs to another user
+bool PVRFilmonData::LoadChannelCache(void) {
+	std::string path = channelCachePath();
+	void *file = XBMC->OpenFile(path.c_str(), 0);
+	if (file == NULL) {
+		XBMC->Log(LOG_DEBUG, "no channel cache at %s", path.c_str());
+		return false;
+	}
+	std::string contents;
+	char buffer[4096];
+	unsigned int bytesRead = 0;
+	while ((bytesRead = XBMC->ReadFile(file, buffer, sizeof(buffer))) > 0) {
+		contents.append(buffer, bytesRead);
+	}
+	XBMC->CloseFile(file);
+
+	Json::Value root;
+	Json::Reader reader;
+	if (!reader.parse(contents, root) || !root.isObject()) {
+		XBMC->Log(LOG_ERROR, "failed to parse channel cache %s", path.c_str());
+		return false;
+	}
+	time_t now = time(0);
+	time_t cacheTime = (time_t) root["time"].asUInt();
+	if (root["username"].asString() != username
+			|| now - cacheTime > FILMON_CACHE_MAX_AGE) {
+		XBMC->Log(LOG_DEBUG, "ignoring stale channel cache");
+		return false;
+	}
+
+	std::vector<PVRFilmonChannel> channels;
+	Json::Value jsonChannels = root["channels"];
+	for (unsigned int i = 0; i < jsonChannels.size(); i++) {
+		Json::Value jsonChannel = jsonChannels[i];
+		PVRFilmonChannel channel;
+		channel.bRadio = false;
+		channel.iUniqueId = jsonChannel["id"].asUInt();
+		channel.iChannelNumber = jsonChannel["number"].asUInt();
+		channel.iEncryptionSystem = 0;
+		channel.strChannelName = jsonChannel["name"].asString();
+		channel.strIconPath = jsonChannel["icon"].asString();
+		channel.strStreamURL = jsonChannel["stream"].asString();
+		Json::Value jsonEpg = jsonChannel["epg"];
+		for (unsigned int j = 0; j < jsonEpg.size(); j++) {
+			Json::Value jsonEntry = jsonEpg[j];
+			PVRFilmonEpgEntry entry;
+			entry.endTime = (time_t) jsonEntry["end"].asUInt();
+			if (entry.endTime < now) {
+				continue;
+			}
+			entry.startTime = (time_t) jsonEntry["start"].asUInt();
+			entry.iBroadcastId = jsonEntry["id"].asUInt();
+			entry.iChannelId = channel.iUniqueId;
+			entry.strTitle = jsonEntry["title"].asString();
+			entry.strPlot = jsonEntry["plot"].asString();
+			entry.strPlotOutline = "";
+			entry.strIconPath = jsonEntry["icon"].asString();
+			entry.iGenreType = jsonEntry["genre"].asInt();
+			entry.iGenreSubType = 0;
+			channel.epg.push_back(entry);
+		}
+		channels.push_back(channel);
+	}
+
+	PLATFORM::CLockObject lock(m_channelMutex);
+	m_channels.swap(channels);
+	lastTimeChannels = cacheTime;
+	channelsFromCache = true;
+	XBMC->Log(LOG_DEBUG, "loaded %d channels from cache", m_channels.size());
+	return !m_channels.empty();
+}
+
+// Called without the channel lock, with a copy of the channels
+void PVRFilmonData::SaveChannelCache(
+		const std::vector<PVRFilmonChannel> &channels, time_t cacheTime) {
+	Json::Value root;
+	root["username"] = username;
+	root["time"] = (Json::UInt) cacheTime;
+	Json::Value jsonChannels(Json::arrayValue);
+	for (unsigned int i = 0; i < channels.size(); i++) {
+		const PVRFilmonChannel &channel = channels[i];
+		Json::Value jsonChannel;
+		jsonChannel["id"] = channel.iUniqueId;
+		jsonChannel["number"] = channel.iChannelNumber;
+		jsonChannel["name"] = channel.strChannelName;
+		jsonChannel["icon"] = channel.strIconPath;
+		jsonChannel["stream"] = channel.strStreamURL;
+		Json::Value jsonEpg(Json::arrayValue);
+		for (unsigned int j = 0; j < channel.epg.size(); j++) {
+			const PVRFilmonEpgEntry &entry = channel.epg[j];
+			Json::Value jsonEntry;
+			jsonEntry["id"] = entry.iBroadcastId;
+			jsonEntry["start"] = (Json::UInt) entry.startTime;
+			jsonEntry["end"] = (Json::UInt) entry.endTime;
+			jsonEntry["title"] = entry.strTitle;
+			jsonEntry["plot"] = entry.strPlot;
+			jsonEntry["icon"] = entry.strIconPath;
+			jsonEntry["genre"] = entry.iGenreType;
+			jsonEpg.append(jsonEntry);
+		}
+		jsonChannel["epg"] = jsonEpg;
+		jsonChannels.append(jsonChannel);
+	}
+	root["channels"] = jsonChannels;
+
+	Json::FastWriter writer;
+	std::string contents = writer.write(root);
+	if (!XBMC->DirectoryExists(g_strUserPath.c_str())) {
+		XBMC->CreateDirectory(g_strUserPath.c_str());
+	}
+	std::string path = channelCachePath();
+	void *file = XBMC->OpenFileForWrite(path.c_str(), true);
+	if (file == NULL) {
+		XBMC->Log(LOG_ERROR, "failed to write channel cache %s", path.c_str());
+		return;
+	}
+	XBMC->WriteFile(file, contents.c_str(), contents.length());
+	XBMC->CloseFile(file);
+}
+
 const char* PVRFilmonData::GetBackendName(void) {
 	return "Filmon API";
 }
@@ -83,45 +320,33 @@ void PVRFilmonData::GetDriveSpace(long long *iTotal, long long *iUsed) {
 }
 
 int PVRFilmonData::GetChannelsAmount(void) {
-	unsigned int chCount = filmonAPIgetChannelCount();
+	unsigned int chCount = 0;
+	{
+		PLATFORM::CLockObject lock(m_channelMutex);
+		chCount = m_channels.size();
+		if (chCount == 0) {
+			chCount = m_channelIds.size();
+		}
+	}
 	XBMC->Log(LOG_DEBUG, "channel count is %d ", chCount);
 	return chCount;
 }
 
 PVR_ERROR PVRFilmonData::GetChannels(ADDON_HANDLE handle, bool bRadio) {
-	PLATFORM::CLockObject lock(m_mutex);
-	bool res = false;
-	bool expired = false;
-	if (time(0) - lastTimeChannels > FILMON_CACHE_TIME) {
-		XBMC->Log(LOG_DEBUG, "cache expired, getting channels from API");
-		m_channels.clear();
-		expired = true;
-	}
-
-	std::vector<unsigned int> channelList = filmonAPIgetChannels();
-	unsigned int channelCount = channelList.size();
-	unsigned int channelId = 0;
-
-	for (unsigned int i = 0; i < channelCount; i++) {
-		FILMON_CHANNEL channel;
-		channelId = channelList[i];
-		if (expired) {
-			res = filmonAPIgetChannel(channelId, &channel);
-			if (onLoad == true) {
-				XBMC->QueueNotification(QUEUE_INFO, "Filmon loaded %s",
-						channel.strChannelName.c_str());
-			}
+	bool empty = false;
+	{
+		PLATFORM::CLockObject lock(m_channelMutex);
+		empty = m_channels.empty();
+	}
+	if (empty) {
+		XBMC->Log(LOG_DEBUG, "no channels cached, getting channels from API");
+		RefreshChannels(false);
+	}
 
-		} else {
-			for (unsigned int j = 0; j < m_channels.size(); j++) {
-				if (m_channels[j].iUniqueId == channelId) {
-					channel = m_channels[j];
-					res = true;
-					break;
-				}
-			}
-		}
-		if (res && channel.bRadio == bRadio) {
+	PLATFORM::CLockObject lock(m_channelMutex);
+	for (unsigned int i = 0; i < m_channels.size(); i++) {
+		PVRFilmonChannel &channel = m_channels[i];
+		if (channel.bRadio == bRadio) {
 			PVR_CHANNEL xbmcChannel;
 			memset(&xbmcChannel, 0, sizeof(PVR_CHANNEL));
 
@@ -136,19 +361,13 @@ PVR_ERROR PVRFilmonData::GetChannels(ADDON_HANDLE handle, bool bRadio) {
 			strncpy(xbmcChannel.strIconPath, channel.strIconPath.c_str(),
 					sizeof(xbmcChannel.strIconPath) - 1);
 			xbmcChannel.bIsHidden = false;
-			if (expired) {
-				m_channels.push_back(channel);
-			}
 			PVR->TransferChannelEntry(handle, &xbmcChannel);
 		}
 	}
-	if (lastTimeChannels == 0) {
+	if (onLoad == true) {
 		XBMC->QueueNotification(QUEUE_INFO, "Filmon loaded %d channels",
 				m_channels.size());
 	}
-	if (expired) {
-		lastTimeChannels = time(0);
-	}
 	onLoad = false;
 	return PVR_ERROR_NO_ERROR;
 }
@@ -209,32 +428,25 @@ PVR_ERROR PVRFilmonData::GetChannelGroupMembers(ADDON_HANDLE handle,
 	return PVR_ERROR_NO_ERROR;
 }
 
-// Returns index into channel vector, refreshes channel entry
-int PVRFilmonData::UpdateChannel(unsigned int channelId) {
-	int index = -1;
-	XBMC->Log(LOG_DEBUG, "updating channel %d ", channelId);
-	for (unsigned int i = 0; i < m_channels.size(); i++) {
-		if (m_channels[i].iUniqueId == channelId) {
-			if (time(0) - lastTimeChannels > FILMON_CACHE_TIME) {
-				XBMC->Log(LOG_DEBUG, "cache expired, getting channel from API");
-				filmonAPIgetChannel(channelId, &m_channels[i]);
-			}
-			index = i;
-			break;
-		}
-	}
-	return index;
-}
-
 // Called periodically to refresh EPG
 PVR_ERROR PVRFilmonData::GetEPGForChannel(ADDON_HANDLE handle,
 		const PVR_CHANNEL &channel, time_t iStart, time_t iEnd) {
-	PLATFORM::CLockObject lock(m_mutex);
 	XBMC->Log(LOG_DEBUG, "getting EPG for channel");
+	if (ChannelsExpired()) {
+		XBMC->Log(LOG_DEBUG, "cache expired, refreshing channels");
+		m_refresh.Signal();
+	}
+	PLATFORM::CLockObject lock(m_channelMutex);
 	unsigned int broadcastIdCount = lastTimeChannels;
-	int chIndex = PVRFilmonData::UpdateChannel(channel.iUniqueId);
+	int chIndex = -1;
+	for (unsigned int i = 0; i < m_channels.size(); i++) {
+		if (m_channels[i].iUniqueId == channel.iUniqueId) {
+			chIndex = i;
+			break;
+		}
+	}
 	if (chIndex >= 0) {
-		PVRFilmonChannel ch = m_channels[chIndex];
+		PVRFilmonChannel &ch = m_channels[chIndex];
 		for (unsigned int epgId = 0; epgId < ch.epg.size(); epgId++) {
 			PVRFilmonEpgEntry &epgEntry = ch.epg.at(epgId);
 			if (epgEntry.startTime >= iStart && epgEntry.endTime <= iEnd) {
@@ -262,13 +474,6 @@ PVR_ERROR PVRFilmonData::GetEPGForChannel(ADDON_HANDLE handle,
 				PVR->TransferEpgEntry(handle, &tag);
 			}
 		}
-		if (time(0) - lastTimeChannels > FILMON_CACHE_TIME) {
-			// Get PVR to re-read refreshed channels
-			if (filmonAPIlogin(username, password)) {
-				PVR->TriggerChannelGroupsUpdate();
-				PVR->TriggerChannelUpdate();
-			}
-		}
 		return PVR_ERROR_NO_ERROR;
 	} else {
 		return PVR_ERROR_SERVER_ERROR;
@@ -24,11 +24,15 @@
 #include <vector>
 #include "platform/util/StdString.h"
 #include "platform/threads/mutex.h"
+#include "platform/threads/threads.h"
 #include "client.h"
 #include "libXBMC_pvr.h"
 #include "FilmonAPI.h"
 
 #define FILMON_CACHE_TIME 10800 // 3 hours
+#define FILMON_CACHE_MAX_AGE 86400 // 1 day, older channel cache files are ignored
+#define FILMON_CACHE_FILE "channels.json"
+#define FILMON_REFRESH_CHECK 60000 // 1 minute
 
 typedef FILMON_EPG_ENTRY PVRFilmonEpgEntry;
 typedef FILMON_CHANNEL PVRFilmonChannel;
@@ -36,7 +40,7 @@ typedef FILMON_RECORDING PVRFilmonRecording;
 typedef FILMON_TIMER PVRFilmonTimer;
 typedef FILMON_CHANNEL_GROUP PVRFilmonChannelGroup;
 
-class PVRFilmonData {
+class PVRFilmonData : public PLATFORM::CThread {
 public:
 	PVRFilmonData(void);
 	virtual ~PVRFilmonData(void);
@@ -69,11 +73,21 @@ public:
 	virtual PVR_ERROR DeleteTimer(const PVR_TIMER &timer, bool bForceDelete);
 	virtual PVR_ERROR UpdateTimer(const PVR_TIMER &timer);
 
+protected:
+	virtual void *Process(void);
+
 private:
-	int UpdateChannel(unsigned int channelId);
-	PLATFORM::CMutex m_mutex;
+	bool ChannelsExpired(void);
+	void RefreshChannels(bool bBackground);
+	bool LoadChannelCache(void);
+	void SaveChannelCache(const std::vector<PVRFilmonChannel> &channels,
+			time_t cacheTime);
+	PLATFORM::CMutex m_mutex; // Serialises Filmon API requests
+	PLATFORM::CMutex m_channelMutex; // Guards channels, never held over requests
+	PLATFORM::CEvent m_refresh;
 	std::vector<PVRFilmonChannelGroup> m_groups;
 	std::vector<PVRFilmonChannel> m_channels;
+	std::vector<unsigned int> m_channelIds; // Subscriber channels as of the last login
 	std::vector<PVRFilmonRecording> m_recordings;
 	std::vector<PVRFilmonTimer> m_timers;
 	time_t lastTimeGroups;
@@ -81,4 +95,5 @@ private:
 	std::string username;
 	std::string password;
 	bool onLoad;
+	bool channelsFromCache;
 };
@@ -28,6 +28,16 @@
 #define READ_TIMEOUT_MS         20000
 #define STREAM_PROPS_TIMEOUT_MS 500
 
+/* demux queue watermarks. above the high watermark B-frames are dropped and
+ * the server is asked to hold back, until the queue is back below the low
+ * watermark. at the limit every packet is dropped */
+#define QUEUE_HIGH_PACKETS      500
+#define QUEUE_LOW_PACKETS       250
+#define QUEUE_MAX_PACKETS       1000
+#define QUEUE_HIGH_BYTES        (8 * 1024 * 1024)
+#define QUEUE_LOW_BYTES         (4 * 1024 * 1024)
+#define QUEUE_MAX_BYTES         (16 * 1024 * 1024)
+
 using namespace std;
 using namespace ADDON;
 using namespace PLATFORM;
@@ -38,6 +48,10 @@ CHTSPDemux::CHTSPDemux(CHTSPConnection* connection) :
     m_subs(0),
     m_channel(0),
     m_tag(0),
+    m_iPacketBytes(0),
+    m_bHasPackets(false),
+    m_bThrottled(false),
+    m_iSpeed(100),
     m_bIsOpen(false)
 {
   m_seekEvent = new CEvent;
@@ -73,6 +87,11 @@ void CHTSPDemux::Close()
 
 void CHTSPDemux::SetSpeed(int speed)
 {
+  {
+    CLockObject lock(m_packetMutex);
+    m_iSpeed     = speed/10;
+    m_bThrottled = false;
+  }
   SendSpeed(m_subs, speed/10);
 }
 
@@ -97,9 +116,124 @@ void CHTSPDemux::Abort()
 
 void CHTSPDemux::Flush(void)
 {
-  DemuxPacket* pkt(NULL);
-  while (m_demuxPacketBuffer.Pop(pkt))
+  // the subscription keeps running, so let the server go on if it was held back
+  CLockObject lock(m_packetMutex);
+  if (ClearQueue())
+    ThrottleServer(false);
+}
+
+/*
+ * Frees all queued packets and resets the throttle state, true if the server
+ * was being held back.
+ */
+bool CHTSPDemux::ClearQueue(void)
+{
+  CLockObject lock(m_packetMutex);
+  while (!m_packets.empty())
+  {
+    PVR->FreeDemuxPacket(m_packets.front());
+    m_packets.pop_front();
+  }
+  m_iPacketBytes = 0;
+  m_bHasPackets  = false;
+
+  bool bThrottled = m_bThrottled;
+  m_bThrottled    = false;
+
+  if (m_queueStats.bdrops || m_queueStats.pdrops || m_queueStats.idrops || m_queueStats.odrops || m_queueStats.throttles)
+    XBMC->Log(LOG_INFO, "%s - dropped %u B-frames, %u P-frames, %u I-frames and %u other packets, throttled the server %u times",
+        __FUNCTION__, m_queueStats.bdrops, m_queueStats.pdrops, m_queueStats.idrops, m_queueStats.odrops, m_queueStats.throttles);
+  m_queueStats.Clear();
+
+  return bThrottled;
+}
+
+/*
+ * Queues a packet for Read(), false if the packet was dropped (and freed)
+ * because the queue is over its high watermark or full.
+ */
+bool CHTSPDemux::PushPacket(DemuxPacket* pkt, uint32_t frametype /* = 0 */)
+{
+  CLockObject lock(m_packetMutex);
+
+  bool bFull = m_packets.size() >= QUEUE_MAX_PACKETS || m_iPacketBytes >= QUEUE_MAX_BYTES;
+  bool bHigh = m_packets.size() >= QUEUE_HIGH_PACKETS || m_iPacketBytes >= QUEUE_HIGH_BYTES;
+
+  // few frames depend on a B-frame (only other B-frames with B-pyramid),
+  // so dropping them does the least damage
+  if (pkt->iSize > 0 && (bFull || (bHigh && frametype == 'B')))
+  {
+    if (frametype == 'B')
+      ++m_queueStats.bdrops;
+    else if (frametype == 'P')
+      ++m_queueStats.pdrops;
+    else if (frametype == 'I')
+      ++m_queueStats.idrops;
+    else
+      ++m_queueStats.odrops;
+
     PVR->FreeDemuxPacket(pkt);
+    pkt = NULL;
+  }
+  else
+  {
+    m_packets.push_back(pkt);
+    m_iPacketBytes += pkt->iSize;
+    m_bHasPackets = true;
+    m_packetCondition.Signal();
+  }
+
+  if (bHigh && !m_bThrottled && m_iSpeed > 0 && m_session->CanTimeshift())
+  {
+    m_bThrottled = true;
+    ++m_queueStats.throttles;
+    ThrottleServer(true);
+  }
+
+  return pkt != NULL;
+}
+
+DemuxPacket* CHTSPDemux::PopPacket(int32_t iTimeoutMs)
+{
+  CLockObject lock(m_packetMutex);
+  if (m_packets.empty() && !m_packetCondition.Wait(m_packetMutex, m_bHasPackets, iTimeoutMs))
+    return NULL;
+  if (m_packets.empty())
+    return NULL;
+
+  DemuxPacket* pkt = m_packets.front();
+  m_packets.pop_front();
+  m_iPacketBytes -= pkt->iSize;
+  m_bHasPackets = !m_packets.empty();
+
+  if (m_bThrottled && m_packets.size() <= QUEUE_LOW_PACKETS && m_iPacketBytes <= QUEUE_LOW_BYTES)
+  {
+    m_bThrottled = false;
+    ThrottleServer(false);
+  }
+
+  return pkt;
+}
+
+/*
+ * Holds the subscription back on the server (which buffers it in its
+ * timeshift) while the queue is over its high watermark. This runs on the
+ * connection's thread for the muxpkts, so it can't wait for the reply.
+ * Called with m_packetMutex held, so the speed changes are sent in the order
+ * they were decided in and a resume can't overtake the pause.
+ */
+void CHTSPDemux::ThrottleServer(bool bThrottle)
+{
+  int speed = bThrottle ? 0 : m_iSpeed;
+  XBMC->Log(LOG_DEBUG, "%s - %s subscription %d (%u packets, %u bytes queued)", __FUNCTION__,
+      bThrottle ? "holding back" : "resuming", m_subs, (unsigned)m_packets.size(), (unsigned)m_iPacketBytes);
+
+  htsmsg_t *m = htsmsg_create_map();
+  htsmsg_add_str(m, "method"        , "subscriptionSpeed");
+  htsmsg_add_s32(m, "subscriptionId", m_subs);
+  htsmsg_add_s32(m, "speed"         , speed);
+  if (m_session->TransmitMessage(m))
+    m_session->SetReadTimeout(speed == 0 ? -1 : READ_TIMEOUT_MS);
 }
 
 bool CHTSPDemux::ProcessMessage(htsmsg* msg)
@@ -153,8 +287,8 @@ DemuxPacket* CHTSPDemux::Read()
   if (!m_session->CheckConnection(1000))
     return PVR->AllocateDemuxPacket(0);
 
-  DemuxPacket* packet(NULL);
-  if (m_demuxPacketBuffer.Pop(packet, 100))
+  DemuxPacket* packet = PopPacket(100);
+  if (packet)
     return packet;
 
   return PVR->AllocateDemuxPacket(0);
@@ -162,7 +296,7 @@ DemuxPacket* CHTSPDemux::Read()
 
 void CHTSPDemux::ParseMuxPacket(htsmsg_t *msg)
 {
-  uint32_t    index, duration;
+  uint32_t    index, duration, frametype;
   const void* bin;
   size_t      binlen;
   int64_t     ts;
@@ -203,7 +337,10 @@ void CHTSPDemux::ParseMuxPacket(htsmsg_t *msg)
     return;
   }
 
-  m_demuxPacketBuffer.Push(pkt);
+  if (htsmsg_get_u32(msg, "frametype", &frametype))
+    frametype = 0;
+
+  PushPacket(pkt, frametype);
 }
 
 bool CHTSPDemux::SwitchChannel(const PVR_CHANNEL &channelinfo)
@@ -381,7 +518,7 @@ void CHTSPDemux::ParseSubscriptionStart(htsmsg_t *m)
 
   DemuxPacket* pkt  = PVR->AllocateDemuxPacket(0);
   pkt->iStreamId    = DMX_SPECIALID_STREAMCHANGE;
-  m_demuxPacketBuffer.Push(pkt);
+  PushPacket(pkt);
 
   if (ParseSourceInfo(m))
   {
@@ -467,7 +604,7 @@ bool CHTSPDemux::SendUnsubscribe(int subscription)
   htsmsg_add_s32(m, "subscriptionId", subscription);
   bool bReturn = m_session->ReadSuccess(m, "unsubscribe from channel");
   m_session->SetReadTimeout(-1);
-  Flush();
+  ClearQueue();
   m_bIsOpen = false;
   return bReturn;
 }
@@ -503,7 +640,8 @@ bool CHTSPDemux::SendSubscribe(int subscription, int channel)
 
   // TODO get this from the pvr api. hardcoded to 10 seconds now
   m_session->SetReadTimeout(READ_TIMEOUT_MS);
-  Flush();
+  // a new subscription starts at normal speed
+  ClearQueue();
 
   XBMC->Log(LOG_DEBUG, "%s - new subscription for channel %d (%d)", __FUNCTION__, m_channel, m_subs);
   return true;
@@ -24,7 +24,7 @@
 
 #include "client.h"
 #include "HTSPConnection.h"
-#include "platform/util/buffer.h"
+#include <deque>
 #include "platform/threads/mutex.h"
 #include "xbmc_stream_utils.hpp"
 
@@ -64,6 +64,10 @@ private:
   bool ParseSignalStatus(htsmsg_t* msg);
   bool ParseTimeshiftStatus(htsmsg_t* msg);
   bool ParseSourceInfo(htsmsg_t* msg);
+  bool PushPacket(DemuxPacket* pkt, uint32_t frametype = 0);
+  DemuxPacket* PopPacket(int32_t iTimeoutMs);
+  bool ClearQueue(void);
+  void ThrottleServer(bool bThrottle);
 
   CHTSPConnection*                     m_session;
   bool                                 m_bIsRadio;
@@ -77,7 +81,14 @@ private:
   SQuality                             m_Quality;
   STimeshiftStatus                     m_timeshiftStatus;
   SSourceInfo                          m_SourceInfo;
-  PLATFORM::SyncedBuffer<DemuxPacket*> m_demuxPacketBuffer;
+  std::deque<DemuxPacket*>             m_packets;
+  size_t                               m_iPacketBytes;
+  bool                                 m_bHasPackets;
+  bool                                 m_bThrottled;
+  int                                  m_iSpeed;
+  SDemuxQueueStats                     m_queueStats;
+  PLATFORM::CMutex                     m_packetMutex;
+  PLATFORM::CCondition<bool>           m_packetCondition;
   bool                                 m_bIsOpen;
   PLATFORM::CEvent*                    m_seekEvent;
   double                               m_seekTime;
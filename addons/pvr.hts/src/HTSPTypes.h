@@ -172,6 +172,25 @@ struct SQueueStatus
   }
 };
 
+struct SDemuxQueueStats
+{
+  uint32_t bdrops;    // Number of B-frames dropped by the addon
+  uint32_t pdrops;    // Number of P-frames dropped by the addon
+  uint32_t idrops;    // Number of I-frames dropped by the addon
+  uint32_t odrops;    // Number of other (audio, subtitle) packets dropped by the addon
+  uint32_t throttles; // Number of times the server was asked to hold back
+
+  SDemuxQueueStats() { Clear(); }
+  void Clear()
+  {
+    bdrops    = 0;
+    pdrops    = 0;
+    idrops    = 0;
+    odrops    = 0;
+    throttles = 0;
+  }
+};
+
 struct STimeshiftStatus
 {
   bool    full;
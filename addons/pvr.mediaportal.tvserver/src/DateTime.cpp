@@ -102,15 +102,42 @@ time_t CDateTime::GetAsTime() const
 }
 
 bool CDateTime::SetFromDateTime(const std::string& dateTime)
+{
+  return SetFromDateTime(dateTime.c_str(), dateTime.length());
+}
+
+static inline bool ParseDigits(const char* str, int count, int& value)
+{
+  value = 0;
+  for (int i = 0; i < count; i++)
+  {
+    if (str[i] < '0' || str[i] > '9')
+      return false;
+    value = value * 10 + (str[i] - '0');
+  }
+  return true;
+}
+
+bool CDateTime::SetFromDateTime(const char* dateTime, size_t length)
 {
   int year, month ,day;
   int hour, minute, second;
-  int count;
-
-  count = sscanf(dateTime.c_str(), "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second);
 
-  if(count != 6)
-    return false;
+  // Fast path for the fixed "yyyy-MM-dd HH:mm:ss" layout that the TVServer
+  // always sends; anything else goes through sscanf
+  if (length < 19 ||
+      dateTime[4] != '-' || dateTime[7] != '-' || dateTime[10] != ' ' ||
+      dateTime[13] != ':' || dateTime[16] != ':' ||
+      !ParseDigits(dateTime, 4, year) || !ParseDigits(dateTime + 5, 2, month) ||
+      !ParseDigits(dateTime + 8, 2, day) || !ParseDigits(dateTime + 11, 2, hour) ||
+      !ParseDigits(dateTime + 14, 2, minute) || !ParseDigits(dateTime + 17, 2, second))
+  {
+    std::string str(dateTime, length);
+    int count = sscanf(str.c_str(), "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second);
+
+    if(count != 6)
+      return false;
+  }
 
   m_time.tm_hour = hour;
   m_time.tm_min = minute;
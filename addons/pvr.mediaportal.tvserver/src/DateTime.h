@@ -60,6 +60,7 @@ public:
    * Assumes the usage of somedatetimeval.ToString("u") in C#
    */
   bool SetFromDateTime(const std::string& dateTime);
+  bool SetFromDateTime(const char* dateTime, size_t length);
 
   /**
    * @brief Sets the date and time from a time_t value
@@ -32,6 +32,8 @@ namespace MPTV
 
 /* Master defines for client control */
 #define RECEIVE_TIMEOUT 6 //sec
+#define RECEIVE_WINDOW_MIN 2048
+#define RECEIVE_WINDOW_MAX (256 * 1024)
 
 Socket::Socket(const enum SocketFamily family, const enum SocketDomain domain, const enum SocketType type, const enum SocketProtocol protocol)
 {
@@ -41,6 +43,8 @@ Socket::Socket(const enum SocketFamily family, const enum SocketDomain domain, c
   _type = type;
   _protocol = protocol;
   memset (&_sockaddr, 0, sizeof( _sockaddr ) );
+  _linecount = 0;
+  resetReadLine();
 }
 
 
@@ -53,6 +57,8 @@ Socket::Socket()
   _type = sock_stream;
   _protocol = tcp;
   memset (&_sockaddr, 0, sizeof( _sockaddr ) );
+  _linecount = 0;
+  resetReadLine();
 }
 
 
@@ -94,17 +100,34 @@ bool Socket::close()
 #endif
     _sd = INVALID_SOCKET;
     osCleanup();
+    resetReadLine();
     return true;
   }
   return false;
 }
 
+void Socket::resetReadLine()
+{
+  if (_linecount > 0)
+  {
+    XBMC->Log(LOG_DEBUG, "%s: %lu lines, %llu bytes per line, %.2f bytes scanned per byte", __FUNCTION__,
+      _linecount, _linebytes / _linecount, (_linebytes ? (double)_scanbytes / _linebytes : 0.0));
+  }
+  _rcvbuf.clear();
+  _rcvscan = 0;
+  _rcvwindow = RECEIVE_WINDOW_MIN;
+  _linecount = 0;
+  _linebytes = 0;
+  _scanbytes = 0;
+}
+
 bool Socket::create()
 {
   if( is_valid() )
   {
     close();
   }
+  resetReadLine();
 
   if(!osInit())
   {
@@ -294,25 +317,43 @@ int Socket::receive ( std::string& data, unsigned int minpacketsize ) const
 }
 
 
-//Receive until error or \n
+//Receive until error or \r\n
 bool Socket::ReadLine (string& line)
 {
   fd_set         set_r, set_e;
   timeval        timeout;
   int            retries = 6;
-  char           buffer[2048];
 
   if (!is_valid())
     return false;
 
   while (true)
   {
-    size_t pos1 = line.find("\r\n", 0);
+    // Only the data received since the last scan is searched, less one byte
+    // for a terminator split between two receives
+    size_t pos1 = _rcvbuf.find("\r\n", _rcvscan);
     if (pos1 != std::string::npos)
     {
-      line.erase(pos1, string::npos);
+      _scanbytes += pos1 + 2 - _rcvscan;
+      _linecount++;
+      _linebytes += pos1;
+      if (pos1 + 2 == _rcvbuf.size())
+      {
+        // Nothing follows the line: hand the buffer over
+        _rcvbuf.erase(pos1);
+        line.swap(_rcvbuf);
+        _rcvbuf.clear();
+      }
+      else
+      {
+        line.assign(_rcvbuf, 0, pos1);
+        _rcvbuf.erase(0, pos1 + 2);
+      }
+      _rcvscan = 0;
       return true;
     }
+    _scanbytes += _rcvbuf.size() - _rcvscan;
+    _rcvscan = (_rcvbuf.empty() ? 0 : _rcvbuf.size() - 1);
 
     timeout.tv_sec  = RECEIVE_TIMEOUT;
     timeout.tv_usec = 0;
@@ -345,17 +386,28 @@ bool Socket::ReadLine (string& line)
       }
     }
 
-    result = recv(_sd, buffer, sizeof(buffer) - 1, 0);
-    if (result < 0)
+    // receive behind the data kept, the string grows geometrically
+    size_t size = _rcvbuf.size();
+    _rcvbuf.resize(size + _rcvwindow);
+    result = recv(_sd, &_rcvbuf[size], _rcvwindow, 0);
+    if (result <= 0)
     {
-      XBMC->Log(LOG_DEBUG, "%s: recv failed", __FUNCTION__);
-      errormessage(getLastError(), __FUNCTION__);
+      _rcvbuf.resize(size);
+      if (result == 0)
+        XBMC->Log(LOG_DEBUG, "%s: connection closed by peer", __FUNCTION__);
+      else
+      {
+        XBMC->Log(LOG_DEBUG, "%s: recv failed", __FUNCTION__);
+        errormessage(getLastError(), __FUNCTION__);
+      }
       _sd = INVALID_SOCKET;
       return false;
     }
-    buffer[result] = 0;
+    _rcvbuf.resize(size + result);
 
-    line.append(buffer);
+    // a full window means more is waiting: ask for more next time
+    if ((size_t)result == _rcvwindow && _rcvwindow < RECEIVE_WINDOW_MAX)
+      _rcvwindow *= 2;
   }
 
   return true;
@@ -270,6 +270,10 @@ class Socket
 
     bool set_non_blocking ( const bool );
 
+    /*!
+     * Read one line terminated by "\r\n", without the terminator.
+     * Bytes received past the terminator are kept for the next call.
+     */
     bool ReadLine (string& line);
 
     bool is_valid() const;
@@ -284,6 +288,13 @@ class Socket
     enum SocketType _type;              ///< Socket Type
     enum SocketDomain _domain;          ///< Socket domain
 
+    string _rcvbuf;                     ///< Received data not returned by ReadLine yet
+    size_t _rcvscan;                    ///< Offset in _rcvbuf where the search for "\r\n" resumes
+    size_t _rcvwindow;                  ///< Bytes asked for per recv, grows with the replies
+    unsigned long _linecount;           ///< Lines returned by ReadLine
+    unsigned long long _linebytes;      ///< Bytes of the lines returned
+    unsigned long long _scanbytes;      ///< Bytes scanned for the terminator
+
     #ifdef TARGET_WINDOWS
       WSADATA _wsaData;                 ///< Windows Socket data
       static int win_usage_count;       ///< Internal Windows usage counter used to prevent a global WSACleanup when more than one Socket object is used
@@ -293,6 +304,7 @@ class Socket
     int getLastError(void) const;
     bool osInit();
     void osCleanup();
+    void resetReadLine();
 };
 
 } //namespace MPTV
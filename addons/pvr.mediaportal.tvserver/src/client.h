@@ -43,6 +43,7 @@ enum eStreamingMethod
 #define DEFAULT_HANDLE_MSG            false
 #define DEFAULT_RESOLVE_RTSP_HOSTNAME false
 #define DEFAULT_READ_GENRE            false
+#define DEFAULT_EPG_PREFETCH          true
 #define DEFAULT_SLEEP_RTSP_URL        0
 #define DEFAULT_USE_REC_DIR           false
 #define DEFAULT_TVGROUP               ""
@@ -64,6 +65,7 @@ extern bool             g_bRadioEnabled;
 extern bool             g_bHandleMessages;
 extern bool             g_bResolveRTSPHostname;
 extern bool             g_bReadGenre;
+extern bool             g_bEpgPrefetch;       ///< Fetch the guide of the next channels in the background
 extern bool             g_bFastChannelSwitch;
 extern bool             g_bUseRTSP;           ///< Use RTSP streaming when using the tsreader
 extern CStdString       g_szTVGroup;
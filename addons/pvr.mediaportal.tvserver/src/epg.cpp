@@ -27,8 +27,15 @@ using namespace std;
 #include "utils.h"
 #include "client.h"
 #include "DateTime.h"
+#include "pvrclient-mediaportal.h"
+#include "platform/util/timeutils.h"
 
 using namespace ADDON;
+using namespace PLATFORM;
+
+#define EPG_PREFETCH_AHEAD  16      // number of channels fetched ahead of the requested one
+#define EPG_PREFETCH_TTL    600000  // ms a prefetched reply stays usable
+#define EPG_PREFETCH_WAIT   20000   // ms to wait for a reply that is being fetched
 
 cEpg::cEpg()
 {
@@ -49,6 +56,8 @@ void cEpg::Reset()
   m_episodePart.clear();
 
   m_uid             = 0;
+  m_iStartTime      = 0;
+  m_iEndTime        = 0;
   m_originalAirDate = 0;
   m_duration        = 0;
   m_genre_type      = 0;
@@ -63,13 +72,31 @@ bool cEpg::ParseLine(string& data)
 {
   try
   {
-    vector<string> epgfields;
+    // Locate the '|' separated fields in place instead of copying them all
+    // into a vector of strings first
+    size_t fieldpos[EPG_FIELD_COUNT];
+    size_t fieldlen[EPG_FIELD_COUNT];
+    size_t fieldcount = 0;
+    size_t start_pos = 0;
 
-    Tokenize(data, epgfields, "|");
+    for (;;)
+    {
+      size_t delim_pos = data.find('|', start_pos);
+      if (fieldcount < EPG_FIELD_COUNT)
+      {
+        fieldpos[fieldcount] = start_pos;
+        fieldlen[fieldcount] = (delim_pos == string::npos ? data.length() : delim_pos) - start_pos;
+      }
+      fieldcount++;
+      if (delim_pos == string::npos)
+        break;
+      start_pos = delim_pos + 1;
+    }
 
-    if( epgfields.size() >= 5 )
+    if( fieldcount >= 5 )
     {
-      //XBMC->Log(LOG_DEBUG, "%s: %s", epgfields[0].c_str(), epgfields[2].c_str());
+      const char* fields = data.c_str();
+
       // field 0 = start date + time
       // field 1 = end   date + time
       // field 2 = title
@@ -85,42 +112,45 @@ bool cEpg::ParseLine(string& data)
       // field 12 = classification (string)
       // field 13 = starRating (int)
       // field 14 = parentalRating (int)
+      // The numeric fields are converted in place, atoi() stops at the '|'
 
-      if( m_startTime.SetFromDateTime(epgfields[0]) == false )
+      if( m_startTime.SetFromDateTime(fields + fieldpos[0], fieldlen[0]) == false )
       {
-        XBMC->Log(LOG_ERROR, "cEpg::ParseLine: Unable to convert start time '%s' into date+time", epgfields[0].c_str());
+        XBMC->Log(LOG_ERROR, "cEpg::ParseLine: Unable to convert start time '%s' into date+time", data.substr(fieldpos[0], fieldlen[0]).c_str());
         return false;
       }
 
-      if( m_endTime.SetFromDateTime(epgfields[1]) == false )
+      if( m_endTime.SetFromDateTime(fields + fieldpos[1], fieldlen[1]) == false )
       {
-        XBMC->Log(LOG_ERROR, "cEpg::ParseLine: Unable to convert end time '%s' into date+time", epgfields[1].c_str());
+        XBMC->Log(LOG_ERROR, "cEpg::ParseLine: Unable to convert end time '%s' into date+time", data.substr(fieldpos[1], fieldlen[1]).c_str());
         return false;
       }
 
-      m_duration  = m_endTime - m_startTime;
+      m_iStartTime = m_startTime.GetAsTime();
+      m_iEndTime = m_endTime.GetAsTime();
+      m_duration  = (int) (m_iEndTime - m_iStartTime);
 
-      m_title = epgfields[2];
-      m_description = epgfields[3];
-      m_shortText = epgfields[2];
-      m_genre = epgfields[4];
+      m_title.assign(data, fieldpos[2], fieldlen[2]);
+      m_description.assign(data, fieldpos[3], fieldlen[3]);
+      m_shortText = m_title;
+      m_genre.assign(data, fieldpos[4], fieldlen[4]);
       if (m_genretable) m_genretable->GenreToTypes(m_genre, m_genre_type, m_genre_subtype);
 
-      if( epgfields.size() >= 15 )
+      if( fieldcount >= 15 )
       {
         // Since TVServerXBMC v1.x.x.104
-        m_uid = (unsigned int) atol(epgfields[5].c_str());
-        m_seriesNumber = atoi(epgfields[7].c_str());
-        m_episodeNumber = atoi(epgfields[8].c_str());
-        m_episodeName = epgfields[9];
-        m_episodePart = epgfields[10];
-        m_starRating = atoi(epgfields[13].c_str());
-        m_parentalRating = atoi(epgfields[14].c_str());
+        m_uid = (unsigned int) atol(fields + fieldpos[5]);
+        m_seriesNumber = atoi(fields + fieldpos[7]);
+        m_episodeNumber = atoi(fields + fieldpos[8]);
+        m_episodeName.assign(data, fieldpos[9], fieldlen[9]);
+        m_episodePart.assign(data, fieldpos[10], fieldlen[10]);
+        m_starRating = atoi(fields + fieldpos[13]);
+        m_parentalRating = atoi(fields + fieldpos[14]);
 
         //originalAirDate
-        if( m_originalAirDate.SetFromDateTime(epgfields[11]) == false )
+        if( m_originalAirDate.SetFromDateTime(fields + fieldpos[11], fieldlen[11]) == false )
         {
-          XBMC->Log(LOG_ERROR, "cEpg::ParseLine: Unable to convert original air date '%s' into date+time", epgfields[11].c_str());
+          XBMC->Log(LOG_ERROR, "cEpg::ParseLine: Unable to convert original air date '%s' into date+time", data.substr(fieldpos[11], fieldlen[11]).c_str());
           return false;
         }
       }
@@ -143,18 +173,185 @@ void cEpg::SetGenreTable(CGenreTable* genretable)
 
 time_t cEpg::StartTime(void) const
 {
-  time_t retval = m_startTime.GetAsTime();
-  return retval;
+  return m_iStartTime;
 }
 
 time_t cEpg::EndTime(void) const
 {
-  time_t retval = m_endTime.GetAsTime();
-  return retval;
+  return m_iEndTime;
 }
 
 time_t cEpg::OriginalAirDate(void) const
 {
-  time_t retval = m_endTime.GetAsTime();
-  return retval;
+  return m_iEndTime;
+}
+
+cEpgPrefetcher::cEpgPrefetcher(cPVRClientMediaPortal& client) :
+  m_client(client),
+  m_next(0),
+  m_last(0),
+  m_inflight(-1),
+  m_start(0),
+  m_end(0),
+  m_hits(0),
+  m_misses(0)
+{
+}
+
+cEpgPrefetcher::~cEpgPrefetcher()
+{
+  Stop();
+}
+
+void cEpgPrefetcher::SetChannels(bool bRadio, const std::vector<int>& channels)
+{
+  CLockObject lock(m_mutex);
+
+  if (bRadio)
+    m_radioChannels = channels;
+  else
+    m_tvChannels = channels;
+
+  m_channels = m_tvChannels;
+  m_channels.insert(m_channels.end(), m_radioChannels.begin(), m_radioChannels.end());
+
+  m_channelIndex.clear();
+  for (size_t i = 0; i < m_channels.size(); i++)
+    m_channelIndex[m_channels[i]] = i;
+
+  m_next = m_last = 0;
+}
+
+bool cEpgPrefetcher::Take(int channel, time_t iStart, time_t iEnd, std::string& result)
+{
+  CLockObject lock(m_mutex);
+
+  std::map<int, size_t>::const_iterator idx = m_channelIndex.find(channel);
+  if (idx == m_channelIndex.end())
+    return false;
+
+  if (m_start <= iStart && m_end >= iEnd)
+  {
+    CTimeout timeout(EPG_PREFETCH_WAIT);
+    while (m_inflight == channel && timeout.TimeLeft() > 0)
+      m_fetched.Wait(m_mutex, timeout.TimeLeft());
+  }
+  else
+  {
+    // Another period, drop what was fetched for the previous one
+    m_replies.clear();
+    m_start = iStart;
+    m_end = iEnd;
+  }
+
+  bool bHit = false;
+  std::map<int, cReply>::iterator it = m_replies.find(channel);
+  if (it != m_replies.end())
+  {
+    if (GetTimeMs() - it->second.fetched < EPG_PREFETCH_TTL)
+    {
+      result.swap(it->second.data);
+      bHit = true;
+    }
+    m_replies.erase(it);
+  }
+
+  if (bHit)
+    m_hits++;
+  else
+    m_misses++;
+
+  // Fetch the channels after this one, and forget the replies outside that
+  // range; XBMC did not ask for them in our order
+  m_next = idx->second + 1;
+  m_last = std::min(m_next + EPG_PREFETCH_AHEAD, m_channels.size());
+
+  for (it = m_replies.begin(); it != m_replies.end();)
+  {
+    size_t pos = m_channelIndex[it->first];
+    if (pos < m_next || pos >= m_last)
+      m_replies.erase(it++);
+    else
+      ++it;
+  }
+
+  if (!IsRunning())
+    CreateThread(false);
+  m_wake.Signal();
+
+  return bHit;
+}
+
+void cEpgPrefetcher::Stop(void)
+{
+  StopThread(-1);
+  m_wake.Signal();
+  // wait until the thread is done with the connection, however long its request takes
+  StopThread(0);
+
+  CLockObject lock(m_mutex);
+  if (m_hits + m_misses > 0)
+    XBMC->Log(LOG_DEBUG, "EPG prefetch: %u of %u channels served from prefetched data", m_hits, m_hits + m_misses);
+
+  m_replies.clear();
+  m_next = m_last = 0;
+  m_inflight = -1;
+  m_start = m_end = 0;
+  m_hits = m_misses = 0;
+  m_fetched.Broadcast();
+}
+
+void* cEpgPrefetcher::Process(void)
+{
+  while (!IsStopped())
+  {
+    int channel;
+    time_t start, end;
+
+    if (!NextChannel(channel, start, end))
+    {
+      m_wake.Wait(1000);
+      continue;
+    }
+
+    std::string result = m_client.RequestEpg(channel, start, end);
+    StoreReply(channel, start, end, result);
+  }
+
+  return NULL;
+}
+
+bool cEpgPrefetcher::NextChannel(int& channel, time_t& start, time_t& end)
+{
+  CLockObject lock(m_mutex);
+
+  while (m_next < m_last)
+  {
+    channel = m_channels[m_next++];
+    if (m_replies.find(channel) == m_replies.end())
+    {
+      start = m_start;
+      end = m_end;
+      m_inflight = channel;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void cEpgPrefetcher::StoreReply(int channel, time_t start, time_t end, std::string& data)
+{
+  CLockObject lock(m_mutex);
+
+  // Failures and empty replies are not kept, GetEpg asks the TVServer itself
+  if (start == m_start && end == m_end && !data.empty() && data.compare(0, 5, "ERROR") != 0 && !IsStopped())
+  {
+    cReply& reply = m_replies[channel];
+    reply.fetched = GetTimeMs();
+    reply.data.swap(data);
+  }
+
+  m_inflight = -1;
+  m_fetched.Broadcast();
 }
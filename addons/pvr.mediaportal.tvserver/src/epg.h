@@ -26,13 +26,18 @@
 
 #include <stdlib.h>
 #include <string>
+#include <vector>
+#include <map>
 #include "libXBMC_addon.h"
 #include "libXBMC_pvr.h"
 #include "GenreTable.h"
 #include "DateTime.h"
+#include "platform/threads/threads.h"
 
 using namespace std;
 
+#define EPG_FIELD_COUNT 15
+
 class cEpg
 {
 private:
@@ -43,6 +48,8 @@ private:
   MPTV::CDateTime m_startTime;
   MPTV::CDateTime m_endTime;
   MPTV::CDateTime m_originalAirDate;
+  time_t m_iStartTime;
+  time_t m_iEndTime;
   int m_duration;
   string m_genre;
   int m_genre_type;
@@ -81,4 +88,65 @@ public:
   void SetGenreTable(CGenreTable* genremap);
 };
 
+class cPVRClientMediaPortal;
+
+/**
+ * Fetches the guide of the channels that follow the one XBMC asked for last,
+ * so the TVServer round trips overlap with XBMC's processing of the previous
+ * channel. The replies are kept (unparsed) until GetEpg takes them. The
+ * TVServerXBMC protocol has no command for the guide of all channels at once.
+ */
+class cEpgPrefetcher : public PLATFORM::CThread
+{
+public:
+  cEpgPrefetcher(cPVRClientMediaPortal& client);
+  virtual ~cEpgPrefetcher();
+
+  /**
+   * @brief Sets the channels in the order in which they are prefetched
+   */
+  void SetChannels(bool bRadio, const std::vector<int>& channels);
+
+  /**
+   * @brief Takes the prefetched GetEPG reply for a channel, if it covers the
+   * given period. The reply may contain entries outside the period. Each call
+   * moves the prefetch window to the channels after the given one.
+   */
+  bool Take(int channel, time_t iStart, time_t iEnd, std::string& result);
+
+  /**
+   * @brief Stops prefetching and drops all replies
+   */
+  void Stop(void);
+
+  virtual void* Process(void);
+
+private:
+  struct cReply
+  {
+    int64_t     fetched;
+    std::string data;
+  };
+
+  bool NextChannel(int& channel, time_t& start, time_t& end);
+  void StoreReply(int channel, time_t start, time_t end, std::string& data);
+
+  cPVRClientMediaPortal&    m_client;
+  PLATFORM::CMutex          m_mutex;
+  PLATFORM::CCondition<bool> m_fetched;
+  PLATFORM::CEvent          m_wake;
+  std::vector<int>          m_tvChannels;
+  std::vector<int>          m_radioChannels;
+  std::vector<int>          m_channels;     ///< TV channels followed by the radio channels
+  std::map<int, size_t>     m_channelIndex; ///< channel id -> position in m_channels
+  std::map<int, cReply>     m_replies;
+  size_t                    m_next;         ///< position of the next channel to fetch
+  size_t                    m_last;         ///< position after the last channel to fetch
+  int                       m_inflight;     ///< channel being fetched, or -1
+  time_t                    m_start;
+  time_t                    m_end;
+  unsigned int              m_hits;
+  unsigned int              m_misses;
+};
+
 #endif //__EPG_H
@@ -225,6 +225,7 @@ void CDeMultiplexer::RequestNewPat(void)
   unsigned long m_Time = GetTickCount();
 
   m_bGotNewChannel = false;
+  m_patParser.RequestChannelInfo();
 
   while( (GetTickCount() - m_Time) < 5000 && m_bGotNewChannel == false)
   {
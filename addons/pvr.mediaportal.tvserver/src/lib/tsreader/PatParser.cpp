@@ -34,6 +34,7 @@ CPatParser::CPatParser(void)
   m_packetsToSkip = 0;
   m_packetsReceived = 0;
   m_pCallback = NULL;
+  m_bReportChannel = false;
   Reset();
   SetPid(0);
   m_iState = Idle;
@@ -51,11 +52,18 @@ void CPatParser::SetCallBack(IPatParserCallback* callback)
 
 void CPatParser::CleanUp()
 {
+  int decoded = SectionsDecoded();
+  int skipped = SectionsSkipped();
+
   for (int i=0; i < (int) m_pmtParsers.size(); ++i)
   {
     CPmtParser* parser = m_pmtParsers[i];
+    decoded += parser->SectionsDecoded();
+    skipped += parser->SectionsSkipped();
     delete parser;
   }
+  if (decoded + skipped > 0)
+    XBMC->Log(LOG_DEBUG, "PatParser: %d PAT/PMT sections decoded, %d unchanged repeats skipped", decoded, skipped);
   m_pmtParsers.clear();
   m_iPatTableVersion = -1;
 }
@@ -64,8 +72,8 @@ void  CPatParser::Reset()
 {
   // Dump();
   XBMC->Log(LOG_DEBUG, "PatParser:Reset()");
-  CSectionDecoder::Reset();
   CleanUp();
+  CSectionDecoder::Reset();
   m_packetsReceived = 0;
   m_iPatTableVersion = -1;
   m_iState = Parsing;
@@ -111,6 +119,12 @@ bool CPatParser::GetChannel(int index, CChannelInfo& info)
   return true;
 }
 
+/// Reports the current channel on the next packet, even if its PMT did not change
+void CPatParser::RequestChannelInfo()
+{
+  m_bReportChannel = true;
+}
+
 void CPatParser::SkipPacketsAtStart(int64_t packets)
 {
   m_packetsToSkip = packets;
@@ -123,12 +137,14 @@ void CPatParser::OnTsPacket(byte* tsPacket)
 
   if (m_packetsReceived > m_packetsToSkip)
   {
+    // Decode the TS header once for the PAT and all PMT decoders
+    m_tsHeader.Decode(tsPacket);
     for (int i=0; i < (int)m_pmtParsers.size(); ++i)
     {
       CPmtParser* parser = m_pmtParsers[i];
-      parser->OnTsPacket(tsPacket);
+      parser->OnTsPacket(m_tsHeader, tsPacket);
     }
-    CSectionDecoder::OnTsPacket(tsPacket);
+    CSectionDecoder::OnTsPacket(m_tsHeader, tsPacket);
   }
 
   if (m_iState==Parsing && m_pCallback!=NULL)
@@ -136,12 +152,15 @@ void CPatParser::OnTsPacket(byte* tsPacket)
     for (int i=0; i < (int)m_pmtParsers.size(); ++i)
     {
       CPmtParser* parser = m_pmtParsers[i];
-      if (true == parser->IsReady()) 
+      // Only report a new or changed PMT, unless RequestChannelInfo() asked for it
+      if (true == parser->IsReady() && (parser->IsUpdated() || m_bReportChannel))
       {
         CChannelInfo info;
         if (GetChannel(i, info))
         {
           m_iState=Idle;
+          parser->ResetUpdated();
+          m_bReportChannel = false;
 
           info.PatVersion = m_iPatTableVersion;
           m_pCallback->OnNewChannel(info);
@@ -51,6 +51,7 @@ public:
   bool        GetChannel(int index, CChannelInfo& info);
   void        Dump();
   void        SetCallBack(IPatParserCallback* callback);
+  void        RequestChannelInfo();
 private:
   void        CleanUp();
   IPatParserCallback* m_pCallback;
@@ -59,4 +60,6 @@ private:
   int64_t     m_packetsToSkip;
   int          m_iPatTableVersion;
   PatState    m_iState;
+  bool        m_bReportChannel; ///< report the channel even if its PMT did not change
+  CTsHeader   m_tsHeader;
 };
@@ -32,6 +32,7 @@ CPmtParser::CPmtParser()
 {
   m_pmtCallback = NULL;
   m_isFound = false;
+  m_isUpdated = false;
 }
 
 CPmtParser::~CPmtParser(void)
@@ -75,6 +76,7 @@ void CPmtParser::OnNewSection(CSection& section)
         m_pmtCallback->OnPmtReceived(GetPid());
       }
     }
+    m_isUpdated = true;
 
     // loop 1
     while (len2 > 0)
@@ -66,10 +66,13 @@ public:
   void        OnNewSection(CSection& section);
   void        SetPmtCallBack(IPmtCallBack* callback);
   bool        IsReady();
+  bool        IsUpdated() const { return m_isUpdated; }
+  void        ResetUpdated() { m_isUpdated = false; }
   CPidTable&  GetPidInfo();
 
 private:
   bool          m_isFound;
+  bool          m_isUpdated; // a new or changed PMT was decoded since ResetUpdated()
   IPmtCallBack* m_pmtCallback;
   CTsHeader     m_tsHeader;
   CPidTable     m_pidInfo;  
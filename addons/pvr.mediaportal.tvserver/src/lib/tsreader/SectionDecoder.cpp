@@ -38,6 +38,8 @@ CSectionDecoder::CSectionDecoder(void)
   m_pCallback = NULL;
   m_bLog = false;
   m_bCrcCheck = true;
+  m_iSectionsDecoded = 0;
+  m_iSectionsSkipped = 0;
 }
 
 CSectionDecoder::~CSectionDecoder(void)
@@ -66,6 +68,9 @@ int CSectionDecoder::GetPid()
 void CSectionDecoder::Reset()
 {
   m_section.Reset();
+  m_sections.clear();
+  m_iSectionsDecoded = 0;
+  m_iSectionsSkipped = 0;
 }
 
 void CSectionDecoder::EnableCrcCheck(bool onOff)
@@ -135,6 +140,38 @@ int CSectionDecoder::AppendSection(byte* tsPacket, int index, int sectionLen)
   return newstart;
 }
 
+static inline uint32_t SectionKey(const CSection& section)
+{
+  return ((uint32_t) section.table_id << 24) | ((uint32_t) (section.table_id_extension & 0xFFFF) << 8) | (uint32_t) (section.section_number & 0xFF);
+}
+
+static inline uint32_t SectionCrc(const CSection& section)
+{
+  const byte* crc = &section.Data[section.section_length - 1];
+  return ((uint32_t) crc[0] << 24) | ((uint32_t) crc[1] << 16) | ((uint32_t) crc[2] << 8) | (uint32_t) crc[3];
+}
+
+/// Returns true when the section has the same version and CRC as the last one
+/// passed on for its table_id/table_id_extension/section_number
+bool CSectionDecoder::IsRepeatedSection(const CSection& section)
+{
+  if (section.section_length < 9)
+    return false;
+
+  std::map<uint32_t, std::pair<int, uint32_t> >::const_iterator it = m_sections.find(SectionKey(section));
+  return (it != m_sections.end() &&
+          it->second.first == section.version_number &&
+          it->second.second == SectionCrc(section));
+}
+
+void CSectionDecoder::RememberSection(const CSection& section)
+{
+  if (section.section_length < 9)
+    return;
+
+  m_sections[SectionKey(section)] = std::make_pair(section.version_number, SectionCrc(section));
+}
+
 int CSectionDecoder::SnapshotSectionLength(byte* tsPacket,int start)
 {
   if (start >= 184)
@@ -207,14 +244,28 @@ void CSectionDecoder::OnTsPacket(CTsHeader& header,byte* tsPacket)
       if (m_section.SectionComplete() && m_section.section_length > 0)
       {
         uint32_t crc = 0;
+        bool repeated = false;
 
         // Only long syntax (section_syntax_indicator == 1) has a CRC
         // Short syntax may have CRC e.g. TOT, but that is part of the specific section
+        // PAT/PMT sections are repeated many times per second; a repeat of the
+        // last section passed on is neither checked nor decoded again
         if (m_section.section_syntax_indicator == 1)
-          crc = crc32( (char*) m_section.Data, m_section.section_length + 3);
+        {
+          repeated = IsRepeatedSection(m_section);
+          if (!repeated)
+            crc = crc32( (char*) m_section.Data, m_section.section_length + 3);
+        }
 
-        if (crc == 0 || (m_bCrcCheck == false))
+        if (repeated)
+        {
+          m_iSectionsSkipped++;
+        }
+        else if (crc == 0 || (m_bCrcCheck == false))
         {
+          if (m_section.section_syntax_indicator == 1)
+            RememberSection(m_section);
+          m_iSectionsDecoded++;
           OnNewSection(m_section);
           if (m_pCallback != NULL)
             m_pCallback->OnNewSection(header.Pid, m_section.table_id, m_section);
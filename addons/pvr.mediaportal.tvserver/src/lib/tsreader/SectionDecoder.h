@@ -25,6 +25,7 @@
 #include "DvbUtil.h"
 #include "Section.h"
 #include "TSHeader.h"
+#include <map>
 
 #define MAX_SECTIONS 256
 
@@ -42,11 +43,15 @@ public:
   void EnableLogging(bool onOff);
   void EnableCrcCheck(bool onOff);
   virtual void OnNewSection(CSection& section);
+  int  SectionsDecoded() const { return m_iSectionsDecoded; }
+  int  SectionsSkipped() const { return m_iSectionsSkipped; }
 protected:
 private:
   int StartNewSection(byte* tsPacket,int index,int sectionLen);
   int AppendSection(byte* tsPacket, int index, int sectionLen);
   int SnapshotSectionLength(byte* tsPacket,int start);
+  bool IsRepeatedSection(const CSection& section);
+  void RememberSection(const CSection& section);
 
   bool              m_bLog;
   bool              m_bCrcCheck;
@@ -56,4 +61,9 @@ private:
   ISectionCallback* m_pCallback;
   CTsHeader         m_header;
   CTsHeader         m_headerSection;
+
+  /* Version and CRC of the last section passed on, per table_id/table_id_extension/section_number */
+  std::map<uint32_t, std::pair<int, uint32_t> > m_sections;
+  int               m_iSectionsDecoded;
+  int               m_iSectionsSkipped;
 };
@@ -20,6 +20,7 @@
 #include <ctime>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "platform/util/timeutils.h"
 
@@ -51,6 +52,10 @@ int g_iTVServerXBMCBuild = 0;
 #define TVSERVERXBMC_RECOMMENDED_VERSION_STRING "1.2.3.122, 1.3.0.122, 1.4.0.124, 1.5.0.125 or 1.6.0.126"
 #define TVSERVERXBMC_RECOMMENDED_VERSION_BUILD  122
 
+/* Bulk command connection */
+#define BULKLANE_RETRY_INTERVAL                 30000 // ms between attempts to open the bulk connection
+#define SLOW_COMMAND_WAIT                       500   // ms a command may wait for its connection before it is logged
+
 /************************************************************/
 /** Class interface */
 
@@ -59,12 +64,15 @@ cPVRClientMediaPortal::cPVRClientMediaPortal()
   m_iCurrentChannel        = -1;
   m_iCurrentCard           = -1;
   m_tcpclient              = new MPTV::Socket(MPTV::af_inet, MPTV::pf_inet, MPTV::sock_stream, MPTV::tcp);
+  m_bulkclient             = new MPTV::Socket(MPTV::af_inet, MPTV::pf_inet, MPTV::sock_stream, MPTV::tcp);
+  m_iBulkRetryTime         = 0;
   m_bConnected             = false;
   m_bStop                  = true;
   m_bTimeShiftStarted      = false;
   m_BackendUTCoffset       = 0;
   m_BackendTime            = 0;
   m_tsreader               = NULL;
+  m_epgPrefetcher          = new cEpgPrefetcher(*this);
   m_genretable             = NULL;
   m_iLastRecordingUpdate   = 0;
   m_signalStateCounter     = 0;
@@ -77,39 +85,17 @@ cPVRClientMediaPortal::~cPVRClientMediaPortal()
   XBMC->Log(LOG_DEBUG, "->~cPVRClientMediaPortal()");
   if (m_bConnected)
     Disconnect();
+  SAFE_DELETE(m_epgPrefetcher);
   SAFE_DELETE(m_tcpclient);
+  SAFE_DELETE(m_bulkclient);
   SAFE_DELETE(m_genretable);
 }
 
 string cPVRClientMediaPortal::SendCommand(string command)
 {
-  PLATFORM::CLockObject critsec(m_mutex);
-
-  if ( !m_tcpclient->send(command) )
-  {
-    if ( !m_tcpclient->is_valid() )
-    {
-      // Connection lost, try to reconnect
-      if ( Connect() == ADDON_STATUS_OK )
-      {
-        // Resend the command
-        if (!m_tcpclient->send(command))
-        {
-          XBMC->Log(LOG_ERROR, "SendCommand('%s') failed.", command.c_str());
-          return "";
-        }
-      }
-      else
-      {
-        XBMC->Log(LOG_ERROR, "SendCommand2: reconnect failed.");
-        return "";
-      }
-    }
-  }
-
   string line;
 
-  if ( !m_tcpclient->ReadLine( line ) )
+  if ( !Transact(command, line) )
   {
     XBMC->Log(LOG_ERROR, "SendCommand - Failed.");
   }
@@ -118,48 +104,176 @@ string cPVRClientMediaPortal::SendCommand(string command)
 
 bool cPVRClientMediaPortal::SendCommand2(string command, vector<string>& lines)
 {
+  string result;
+
+  if (!Transact(command, result))
+  {
+    XBMC->Log(LOG_ERROR, "SendCommand2 - Failed.");
+    return false;
+  }
+
+  if (result.find("[ERROR]:") != std::string::npos)
+  {
+    XBMC->Log(LOG_ERROR, "TVServerXBMC error: %s", result.c_str());
+    return false;
+  }
+
+  Tokenize(result, lines, ",");
+
+  return true;
+}
+
+/* Commands that only read listings from the TVServer and don't depend on the
+ * connection state. These are the ones that can produce large replies. */
+bool cPVRClientMediaPortal::IsBulkCommand(const string& command)
+{
+  static const char* bulkcommands[] = {
+    "GetEPG:",
+    "ListGroups",
+    "ListRadioGroups",
+    "ListTVChannels",
+    "ListRadioChannels",
+    "ListRecordings",
+    "ListSchedules",
+    "GetRecordingInfo:",
+    "GetScheduleInfo:",
+    NULL
+  };
+
+  for (int i = 0; bulkcommands[i] != NULL; i++)
+  {
+    if (command.compare(0, strlen(bulkcommands[i]), bulkcommands[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+bool cPVRClientMediaPortal::Transact(const string& command, string& line)
+{
+  if (IsBulkCommand(command) && TransactBulk(command, line))
+    return true;
+
+  int64_t iWaitStart = PLATFORM::GetTimeMs();
   PLATFORM::CLockObject critsec(m_mutex);
+  AddCommandWait(command, PLATFORM::GetTimeMs() - iWaitStart);
 
   if ( !m_tcpclient->send(command) )
   {
     if ( !m_tcpclient->is_valid() )
     {
-      XBMC->Log(LOG_ERROR, "SendCommand2: connection lost, attempt to reconnect...");
+      XBMC->Log(LOG_ERROR, "SendCommand: connection lost, attempt to reconnect...");
       // Connection lost, try to reconnect
       if ( Connect() == ADDON_STATUS_OK )
       {
         // Resend the command
         if (!m_tcpclient->send(command))
         {
-          XBMC->Log(LOG_ERROR, "SendCommand2('%s') failed.", command.c_str());
+          XBMC->Log(LOG_ERROR, "SendCommand('%s') failed.", command.c_str());
           return false;
         }
       }
       else
       {
-        XBMC->Log(LOG_ERROR, "SendCommand2: reconnect failed.");
+        XBMC->Log(LOG_ERROR, "SendCommand: reconnect failed.");
         return false;
       }
     }
   }
 
-  string result;
+  return m_tcpclient->ReadLine(line);
+}
 
-  if (!m_tcpclient->ReadLine(result))
-  {
-    XBMC->Log(LOG_ERROR, "SendCommand2 - Failed.");
+/* Sends a listing command over the bulk lane. Returns false when the bulk lane
+ * is not available; the caller then uses the control lane. */
+bool cPVRClientMediaPortal::TransactBulk(const string& command, string& line)
+{
+  int64_t iWaitStart = PLATFORM::GetTimeMs();
+  PLATFORM::CLockObject critsec(m_bulkmutex);
+  int64_t iWaitMs = PLATFORM::GetTimeMs() - iWaitStart;
+
+  if (!m_bulkclient->is_valid() && !ConnectBulkLane())
     return false;
+
+  AddCommandWait(command, iWaitMs);
+
+  if (!m_bulkclient->send(command))
+  {
+    // Connection lost, reconnect this lane only
+    if (m_bulkclient->is_valid() || !ConnectBulkLane() || !m_bulkclient->send(command))
+    {
+      XBMC->Log(LOG_ERROR, "SendCommand('%s') failed on the bulk connection.", command.c_str());
+      return false;
+    }
   }
 
-  if (result.find("[ERROR]:") != std::string::npos)
+  if (!m_bulkclient->ReadLine(line))
   {
-    XBMC->Log(LOG_ERROR, "TVServerXBMC error: %s", result.c_str());
+    // Drop the connection, the (read-only) command is repeated on the control lane
+    XBMC->Log(LOG_ERROR, "SendCommand - Failed on the bulk connection.");
+    m_bulkclient->close();
+    line.clear();
     return false;
   }
+  return true;
+}
 
-  Tokenize(result, lines, ",");
+/* Opens the bulk lane. Only done while the control lane is up, and not more
+ * than once per BULKLANE_RETRY_INTERVAL after a failure, so an unreachable
+ * backend doesn't cost two connect timeouts per command. */
+bool cPVRClientMediaPortal::ConnectBulkLane(void)
+{
+  if (!m_bConnected || PLATFORM::GetTimeMs() < m_iBulkRetryTime)
+    return false;
 
-  return true;
+  m_bulkclient->close();
+
+  if (m_bulkclient->create() &&
+      m_bulkclient->connect(g_szHostname, (unsigned short) g_iPort))
+  {
+    m_bulkclient->set_non_blocking(1);
+
+    string result;
+    if (m_bulkclient->send("PVRclientXBMC:0-1\n") &&
+        m_bulkclient->ReadLine(result) &&
+        result.find('|') != std::string::npos)
+    {
+      XBMC->Log(LOG_DEBUG, "Opened the bulk connection to %s:%i", g_szHostname.c_str(), g_iPort);
+      m_iBulkRetryTime = 0;
+      return true;
+    }
+  }
+
+  XBMC->Log(LOG_INFO, "Could not open the bulk connection, using the main connection for all commands.");
+  m_bulkclient->close();
+  m_iBulkRetryTime = PLATFORM::GetTimeMs() + BULKLANE_RETRY_INTERVAL;
+  return false;
+}
+
+void cPVRClientMediaPortal::AddCommandWait(const string& command, int64_t waitMs)
+{
+  string name = command.substr(0, command.find_first_of(":\n"));
+
+  if (waitMs >= SLOW_COMMAND_WAIT)
+    XBMC->Log(LOG_DEBUG, "SendCommand: '%s' waited %lld ms for its connection.", name.c_str(), (long long) waitMs);
+
+  PLATFORM::CLockObject lock(m_statsmutex);
+  cCommandStats& stats = m_commandStats[name];
+  stats.count++;
+  stats.waitTotalMs += waitMs;
+  if (waitMs > stats.waitMaxMs)
+    stats.waitMaxMs = waitMs;
+}
+
+void cPVRClientMediaPortal::LogCommandStats(void)
+{
+  PLATFORM::CLockObject lock(m_statsmutex);
+
+  for (std::map<string, cCommandStats>::const_iterator it = m_commandStats.begin(); it != m_commandStats.end(); ++it)
+  {
+    XBMC->Log(LOG_DEBUG, "Command '%s': %u sent, connection wait total %lld ms, max %lld ms",
+      it->first.c_str(), it->second.count, (long long) it->second.waitTotalMs, (long long) it->second.waitMaxMs);
+  }
+  m_commandStats.clear();
 }
 
 ADDON_STATUS cPVRClientMediaPortal::Connect()
@@ -273,8 +387,18 @@ void cPVRClientMediaPortal::Disconnect()
 
   m_bStop = true;
 
+  m_epgPrefetcher->Stop();
+
   m_tcpclient->close();
 
+  {
+    PLATFORM::CLockObject critsec(m_bulkmutex);
+    m_bulkclient->close();
+    m_iBulkRetryTime = 0;
+  }
+
+  LogCommandStats();
+
   m_bConnected = false;
 }
 
@@ -441,31 +565,42 @@ PVR_ERROR cPVRClientMediaPortal::GetBackendTime(time_t *localTime, int *gmtOffse
 /************************************************************/
 /** EPG handling */
 
-PVR_ERROR cPVRClientMediaPortal::GetEpg(ADDON_HANDLE handle, const PVR_CHANNEL &channel, time_t iStart, time_t iEnd)
+string cPVRClientMediaPortal::RequestEpg(int channel, time_t iStart, time_t iEnd)
 {
-  vector<string> lines;
   char           command[256];
-  string         result;
-  cEpg           epg;
-  EPG_TAG        broadcast;
   struct tm      starttime;
   struct tm      endtime;
 
   starttime = *gmtime( &iStart );
   endtime = *gmtime( &iEnd );
 
-  if (!IsUp())
-    return PVR_ERROR_SERVER_ERROR;
-
   // Request (extended) EPG data for the given period
   snprintf(command, 256, "GetEPG:%i|%04d-%02d-%02dT%02d:%02d:%02d.0Z|%04d-%02d-%02dT%02d:%02d:%02d.0Z\n",
-          channel.iUniqueId,                                                 //Channel id
+          channel,                                                           //Channel id
           starttime.tm_year + 1900, starttime.tm_mon + 1, starttime.tm_mday, //Start date     [2..4]
           starttime.tm_hour, starttime.tm_min, starttime.tm_sec,             //Start time     [5..7]
           endtime.tm_year + 1900, endtime.tm_mon + 1, endtime.tm_mday,       //End date       [8..10]
           endtime.tm_hour, endtime.tm_min, endtime.tm_sec);                  //End time       [11..13]
 
-  result = SendCommand(command);
+  return SendCommand(command);
+}
+
+PVR_ERROR cPVRClientMediaPortal::GetEpg(ADDON_HANDLE handle, const PVR_CHANNEL &channel, time_t iStart, time_t iEnd)
+{
+  string         data;
+  string         result;
+  cEpg           epg;
+  EPG_TAG        broadcast;
+  bool           bPrefetched = false;
+
+  if (!IsUp())
+    return PVR_ERROR_SERVER_ERROR;
+
+  if (g_bEpgPrefetch)
+    bPrefetched = m_epgPrefetcher->Take(channel.iUniqueId, iStart, iEnd, result);
+
+  if (!bPrefetched)
+    result = RequestEpg(channel.iUniqueId, iStart, iEnd);
 
   if(result.compare(0,5, "ERROR") != 0)
   {
@@ -474,13 +609,18 @@ PVR_ERROR cPVRClientMediaPortal::GetEpg(ADDON_HANDLE handle, const PVR_CHANNEL &
       memset(&broadcast, 0, sizeof(EPG_TAG));
       epg.SetGenreTable(m_genretable);
 
-      Tokenize(result, lines, ",");
-
-      XBMC->Log(LOG_DEBUG, "Found %i EPG items for channel %i\n", lines.size(), channel.iUniqueId);
+      int count = 0;
+      string::size_type start_pos = 0;
+      string::size_type delim_pos = 0;
 
-      for (vector<string>::iterator it = lines.begin(); it < lines.end(); ++it)
+      // Walk the ',' separated items in place, only the current one is copied
+      // (the uri decoding is done in that copy)
+      while (delim_pos != string::npos)
       {
-        string& data(*it);
+        delim_pos = result.find(',', start_pos);
+        data.assign(result, start_pos, (delim_pos == string::npos ? result.length() : delim_pos) - start_pos);
+        start_pos = delim_pos + 1;
+        count++;
 
         if( data.length() > 0)
         {
@@ -488,7 +628,9 @@ PVR_ERROR cPVRClientMediaPortal::GetEpg(ADDON_HANDLE handle, const PVR_CHANNEL &
 
           bool isEnd = epg.ParseLine(data);
 
-          if (isEnd && epg.StartTime() != 0)
+          // A prefetched reply can cover a longer period than asked for
+          if (isEnd && epg.StartTime() != 0 &&
+              (!bPrefetched || (epg.EndTime() > iStart && epg.StartTime() < iEnd)))
           {
             broadcast.iUniqueBroadcastId  = epg.UniqueId();
             broadcast.strTitle            = epg.Title();
@@ -515,6 +657,8 @@ PVR_ERROR cPVRClientMediaPortal::GetEpg(ADDON_HANDLE handle, const PVR_CHANNEL &
           epg.Reset();
         }
       }
+
+      XBMC->Log(LOG_DEBUG, "Found %i EPG items for channel %i%s\n", count, channel.iUniqueId, bPrefetched ? " (prefetched)" : "");
     }
     else
     {
@@ -638,6 +782,8 @@ PVR_ERROR cPVRClientMediaPortal::GetChannels(ADDON_HANDLE handle, bool bRadio)
 
   memset(&tag, 0, sizeof(PVR_CHANNEL));
 
+  vector<int> channelIds;
+
   for (vector<string>::iterator it = lines.begin(); it < lines.end(); ++it)
   {
     string& data(*it);
@@ -726,10 +872,13 @@ PVR_ERROR cPVRClientMediaPortal::GetChannels(ADDON_HANDLE handle, bool bRadio)
       if( (!g_bOnlyFTA) || (tag.iEncryptionSystem==0))
       {
         PVR->TransferChannelEntry(handle, &tag);
+        channelIds.push_back(tag.iUniqueId);
       }
     }
   }
 
+  m_epgPrefetcher->SetChannels(bRadio, channelIds);
+
   //pthread_mutex_unlock(&m_critSection);
   return PVR_ERROR_NO_ERROR;
 }
@@ -19,6 +19,7 @@
  */
 
 #include <vector>
+#include <map>
 
 /* Master defines for client control */
 #include "xbmc_pvr_types.h"
@@ -34,6 +35,8 @@ class CTsReader;
 
 class cPVRClientMediaPortal: public PLATFORM::PreventCopy
 {
+  friend class cEpgPrefetcher;
+
 public:
   /* Class interface */
   cPVRClientMediaPortal();
@@ -107,6 +110,7 @@ public:
 
 protected:
   MPTV::Socket           *m_tcpclient;
+  MPTV::Socket           *m_bulkclient;
 
 private:
   bool GetChannel(unsigned int number, PVR_CHANNEL &channeldata);
@@ -127,8 +131,11 @@ private:
   CCards                  m_cCards;
   CGenreTable*            m_genretable;
   PLATFORM::CMutex        m_mutex;
+  PLATFORM::CMutex        m_bulkmutex;
+  int64_t                 m_iBulkRetryTime;
   int64_t                 m_iLastRecordingUpdate;
   CTsReader*              m_tsreader;
+  cEpgPrefetcher*         m_epgPrefetcher;
   std::map<int,std::string> m_channelNames;
   int                     m_signalStateCounter;
   int                     m_iSignal;
@@ -137,6 +144,32 @@ private:
   void Close();
 
   //Used for TV Server communication:
+  std::string RequestEpg(int channel, time_t iStart, time_t iEnd);
   std::string SendCommand(std::string command);
   bool SendCommand2(std::string command, std::vector<std::string>& lines);
+
+  /* The TVServer commands go over two connections ("lanes"). m_tcpclient is
+   * the control lane: it does the handshake and carries everything that
+   * depends on the per-connection state in TVServerXBMC (timeshifting, the
+   * current card, signal quality) and all modifications. m_bulkclient is the
+   * bulk lane for the long, stateless listings (EPG, channels, recordings,
+   * schedules), so a big reply doesn't hold up a channel switch or the signal
+   * polling. The bulk lane connects on first use and falls back to the
+   * control lane when it can't be opened. */
+  bool Transact(const std::string& command, std::string& line);
+  bool TransactBulk(const std::string& command, std::string& line);
+  bool ConnectBulkLane(void);
+  static bool IsBulkCommand(const std::string& command);
+
+  struct cCommandStats
+  {
+    unsigned int count;
+    int64_t      waitTotalMs;
+    int64_t      waitMaxMs;
+  };
+  void AddCommandWait(const std::string& command, int64_t waitMs);
+  void LogCommandStats(void);
+
+  PLATFORM::CMutex        m_statsmutex;
+  std::map<std::string, cCommandStats> m_commandStats;
 };
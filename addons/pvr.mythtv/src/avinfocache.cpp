@@ -0,0 +1,234 @@
+/*
+ *      Copyright (C) 2005-2014 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "avinfocache.h"
+#include "avinfo.h"
+#include "client.h"
+
+#include <mythrecordingplayback.h>
+
+#include <stdio.h>
+
+#define AVINFOCACHE_FILENAME    "avinfo.cache"
+#define AVINFOCACHE_MAXLINESIZE 256
+
+using namespace ADDON;
+using namespace PLATFORM;
+
+AVInfoCache::AVInfoCache(const std::string& server, unsigned protoPort)
+: CThread()
+, m_server(server)
+, m_protoPort(protoPort)
+, m_filePath(g_szUserPath + AVINFOCACHE_FILENAME)
+, m_changed(false)
+{
+  Load();
+  CreateThread();
+}
+
+AVInfoCache::~AVInfoCache()
+{
+  Suspend();
+  CLockObject lock(m_lock);
+  if (m_changed)
+    Save();
+}
+
+bool AVInfoCache::Lookup(MythProgramInfo& programInfo)
+{
+  CLockObject lock(m_lock);
+  std::map<std::string, Entry>::const_iterator it = m_entries.find(programInfo.UID());
+  // The head of the file doesn't change while recording, but a smaller file
+  // has been rewritten (i.e transcoded)
+  if (it == m_entries.end() || it->second.fileSize > programInfo.FileSize())
+    return false;
+  programInfo.SetPropsVideoFrameRate(it->second.videoFrameRate);
+  programInfo.SetPropsVideoAspec(it->second.videoAspec);
+  return true;
+}
+
+bool AVInfoCache::Probe(MythProgramInfo& programInfo, Myth::Stream *stream)
+{
+  Entry entry;
+  entry.fileSize = programInfo.FileSize();
+  entry.videoFrameRate = programInfo.GetPropsVideoFrameRate();
+  if (!ProbeEntry(stream, entry))
+    return false;
+  programInfo.SetPropsVideoFrameRate(entry.videoFrameRate);
+  programInfo.SetPropsVideoAspec(entry.videoAspec);
+  Store(programInfo.UID(), entry);
+  return true;
+}
+
+bool AVInfoCache::ProbeEntry(Myth::Stream *stream, Entry& entry)
+{
+  AVInfo info(stream);
+  AVInfo::STREAM_AVINFO mInfo;
+  if (!info.GetMainStream(&mInfo))
+    return false;
+
+  // Set video frame rate
+  if (mInfo.stream_info.fps_scale > 0)
+  {
+    switch(mInfo.stream_type)
+    {
+      case STREAM_TYPE_VIDEO_H264:
+        entry.videoFrameRate = (float)(mInfo.stream_info.fps_rate) / (mInfo.stream_info.fps_scale * (mInfo.stream_info.interlaced ? 2 : 1));
+        break;
+      default:
+        entry.videoFrameRate = (float)(mInfo.stream_info.fps_rate) / mInfo.stream_info.fps_scale;
+    }
+  }
+  // Set video aspec
+  entry.videoAspec = mInfo.stream_info.aspect;
+  return true;
+}
+
+void AVInfoCache::Queue(const MythProgramInfo& programInfo)
+{
+  CLockObject lock(m_lock);
+  // Each recording is queued once: a failed probe isn't retried until restart
+  if (!m_queued.insert(programInfo.UID()).second)
+    return;
+  m_jobQueue.push_back(programInfo);
+  m_queueContent.Signal();
+}
+
+void AVInfoCache::Suspend()
+{
+  if (IsRunning())
+  {
+    StopThread(-1); // Set stopping. don't wait as we need to signal the thread first
+    m_queueContent.Signal();
+    StopThread(); // Wait for thread to stop
+  }
+}
+
+void AVInfoCache::Resume()
+{
+  if (IsStopped())
+    CreateThread();
+}
+
+void *AVInfoCache::Process()
+{
+  Myth::RecordingPlayback *playback = NULL;
+
+  while (!IsStopped())
+  {
+    while (!IsStopped())
+    {
+      CLockObject lock(m_lock);
+      if (m_jobQueue.empty())
+      {
+        // Save new entries once the queue is done
+        if (m_changed)
+          Save();
+        break;
+      }
+      MythProgramInfo prog = m_jobQueue.front();
+      m_jobQueue.pop_front();
+      lock.Unlock();
+
+      // Connection is opened on first job and kept until the thread stops
+      if (!playback)
+        playback = new Myth::RecordingPlayback(m_server, m_protoPort);
+      if (!playback->IsOpen() && !playback->Open())
+      {
+        // Not probed: let the next refresh of the recordings queue it again
+        lock.Lock();
+        m_queued.erase(prog.UID());
+        break;
+      }
+      if (playback->OpenTransfer(prog.GetPtr()))
+      {
+        // Don't touch the props of prog, they are shared with the recordings map
+        Entry entry;
+        entry.fileSize = prog.FileSize();
+        entry.videoFrameRate = 0;
+        bool ok = ProbeEntry(playback, entry);
+        if (ok)
+          Store(prog.UID(), entry);
+        playback->CloseTransfer();
+        if (g_bExtraDebug)
+          XBMC->Log(LOG_DEBUG, "%s: probe %s %s", __FUNCTION__, prog.UID().c_str(), (ok ? "done" : "failed"));
+      }
+    }
+    m_queueContent.Wait();
+  }
+
+  SAFE_DELETE(playback);
+  return NULL;
+}
+
+void AVInfoCache::Store(const std::string& uid, const Entry& entry)
+{
+  CLockObject lock(m_lock);
+  m_entries[uid] = entry;
+  m_changed = true;
+}
+
+void AVInfoCache::Load()
+{
+  void *file = XBMC->OpenFile(m_filePath.c_str(), 0);
+  if (!file)
+    return;
+
+  char line[AVINFOCACHE_MAXLINESIZE];
+  char uid[AVINFOCACHE_MAXLINESIZE];
+  while (XBMC->ReadFileString(file, line, AVINFOCACHE_MAXLINESIZE))
+  {
+    // uid filesize framerate aspec
+    Entry entry;
+    long long fileSize;
+    if (sscanf(line, "%s %lld %f %f", uid, &fileSize, &entry.videoFrameRate, &entry.videoAspec) == 4)
+    {
+      entry.fileSize = (int64_t)fileSize;
+      m_entries[uid] = entry;
+    }
+  }
+  XBMC->CloseFile(file);
+  XBMC->Log(LOG_DEBUG, "%s: Loaded %u entries", __FUNCTION__, (unsigned)m_entries.size());
+}
+
+void AVInfoCache::Save()
+{
+  void *file = XBMC->OpenFileForWrite(m_filePath.c_str(), true);
+  if (!file)
+  {
+    XBMC->Log(LOG_ERROR, "%s: Failed to write %s", __FUNCTION__, m_filePath.c_str());
+    return;
+  }
+
+  char line[AVINFOCACHE_MAXLINESIZE];
+  for (std::map<std::string, Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    int len = snprintf(line, sizeof(line), "%s %lld %.3f %.3f\n", it->first.c_str(),
+                       (long long)it->second.fileSize, it->second.videoFrameRate, it->second.videoAspec);
+    if (len > 0 && len < (int)sizeof(line))
+      XBMC->WriteFile(file, line, len);
+  }
+  XBMC->CloseFile(file);
+  m_changed = false;
+  if (g_bExtraDebug)
+    XBMC->Log(LOG_DEBUG, "%s: Saved %u entries", __FUNCTION__, (unsigned)m_entries.size());
+}
@@ -0,0 +1,84 @@
+#pragma once
+/*
+ *      Copyright (C) 2005-2014 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "cppmyth/MythProgramInfo.h"
+
+#include <mythstream.h>
+#include <platform/threads/threads.h>
+#include <platform/threads/mutex.h>
+
+#include <string>
+#include <list>
+#include <set>
+#include <map>
+
+/**
+ * Keeps the stream properties (frame rate, aspect) of recordings probed by
+ * AVInfo, keyed by recording UID and file size, and saves them in the user
+ * path. Recordings not known yet can be queued to be probed in background.
+ * The background prober only fills the cache: the props of a recording are
+ * shared by its copies, so they are set by Lookup() in the caller's thread.
+ */
+class AVInfoCache : public PLATFORM::CThread
+{
+public:
+  AVInfoCache(const std::string& server, unsigned protoPort);
+  ~AVInfoCache();
+
+  // Set the cached props of the recording. Returns false if none is valid
+  bool Lookup(MythProgramInfo& programInfo);
+  // Probe the stream, set the props of the recording and cache them
+  bool Probe(MythProgramInfo& programInfo, Myth::Stream *stream);
+  // Queue the recording for the background prober
+  void Queue(const MythProgramInfo& programInfo);
+
+  void Suspend();
+  void Resume();
+
+protected:
+  void *Process();
+
+private:
+  struct Entry
+  {
+    int64_t fileSize;
+    float   videoFrameRate;
+    float   videoAspec;
+  };
+
+  static bool ProbeEntry(Myth::Stream *stream, Entry& entry);
+  void Store(const std::string& uid, const Entry& entry);
+  void Load();
+  void Save();
+
+  std::string m_server;
+  unsigned m_protoPort;
+  std::string m_filePath;
+
+  PLATFORM::CMutex m_lock;
+  PLATFORM::CEvent m_queueContent;
+  std::map<std::string, Entry> m_entries;
+  std::list<MythProgramInfo> m_jobQueue;
+  std::set<std::string> m_queued;
+  bool m_changed;
+};
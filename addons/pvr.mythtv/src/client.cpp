@@ -51,6 +51,7 @@ bool          g_bRecAutoExpire          = false;
 int           g_iRecTranscoder          = 0;
 bool          g_bDemuxing               = DEFAULT_HANDLE_DEMUXING;
 int           g_iTuneDelay              = DEFAULT_TUNE_DELAY;
+int           g_iLiveTVBuffer           = DEFAULT_LIVETV_BUFFER;
 int           g_iGroupRecordings        = GROUP_RECORDINGS_ALWAYS;
 int           g_iEnableEDL              = ENABLE_EDL_ALWAYS;
 bool          g_bBlockMythShutdown      = DEFAULT_BLOCK_SHUTDOWN;
@@ -237,6 +238,14 @@ ADDON_STATUS ADDON_Create(void *hdl, void *props)
     g_iTuneDelay = DEFAULT_TUNE_DELAY;
   }
 
+  /* Read setting "livetv_buffer" from settings.xml */
+  if (!XBMC->GetSetting("livetv_buffer", &g_iLiveTVBuffer))
+  {
+    /* If setting is unknown fallback to defaults */
+    XBMC->Log(LOG_ERROR, "Couldn't get 'livetv_buffer' setting, falling back to '%d' as default", DEFAULT_LIVETV_BUFFER);
+    g_iLiveTVBuffer = DEFAULT_LIVETV_BUFFER;
+  }
+
   /* Read setting "host_ether" from settings.xml */
   if (XBMC->GetSetting("host_ether", buffer))
     g_szMythHostEther = buffer;
@@ -549,6 +558,12 @@ ADDON_STATUS ADDON_SetSetting(const char *settingName, const void *settingValue)
     if (g_iTuneDelay != *(int*)settingValue)
       g_iTuneDelay = *(int*)settingValue;
   }
+  else if (str == "livetv_buffer")
+  {
+    XBMC->Log(LOG_INFO, "Changed Setting 'livetv_buffer' from %d to %d", g_iLiveTVBuffer, *(int*)settingValue);
+    if (g_iLiveTVBuffer != *(int*)settingValue)
+      g_iLiveTVBuffer = *(int*)settingValue;
+  }
   else if (str == "group_recordings")
   {
     XBMC->Log(LOG_INFO, "Changed Setting 'group_recordings' from %u to %u", g_iGroupRecordings, *(int*)settingValue);
@@ -56,6 +56,7 @@
 
 #define DEFAULT_HANDLE_DEMUXING             false
 #define DEFAULT_TUNE_DELAY                  5
+#define DEFAULT_LIVETV_BUFFER               1
 #define GROUP_RECORDINGS_ALWAYS             0
 #define GROUP_RECORDINGS_ONLY_FOR_SERIES    1
 #define GROUP_RECORDINGS_NEVER              2
@@ -101,6 +102,7 @@ extern bool         g_bRecAutoExpire;
 extern int          g_iRecTranscoder;
 extern bool         g_bDemuxing;
 extern int          g_iTuneDelay;
+extern int          g_iLiveTVBuffer;
 extern int          g_iGroupRecordings;
 extern int          g_iEnableEDL;
 extern bool         g_bBlockMythShutdown;
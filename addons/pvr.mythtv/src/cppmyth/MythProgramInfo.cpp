@@ -202,6 +202,11 @@ std::string MythProgramInfo::FileName() const
   return (m_proginfo ? m_proginfo->fileName : "");
 }
 
+int64_t MythProgramInfo::FileSize() const
+{
+  return (m_proginfo ? m_proginfo->fileSize : 0);
+}
+
 std::string MythProgramInfo::Description() const
 {
   return (m_proginfo ? m_proginfo->description : "");
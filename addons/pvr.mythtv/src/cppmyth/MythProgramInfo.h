@@ -60,6 +60,7 @@ public:
   std::string Subtitle() const;
   std::string HostName() const;
   std::string FileName() const;
+  int64_t FileSize() const;
   std::string Description() const;
   int Duration() const;
   std::string Category() const;
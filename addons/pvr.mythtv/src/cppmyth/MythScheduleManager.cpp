@@ -582,60 +582,124 @@ void MythScheduleManager::CloseControl()
     m_control->Close();
 }
 
-void MythScheduleManager::Update()
+// Compare the rule fields shown by timers
+static bool SameTimerRule(const MythRecordingRule &first, const MythRecordingRule &second)
 {
-  CLockObject lock(m_lock);
+  return
+  first.Type() == second.Type() &&
+          first.Inactive() == second.Inactive() &&
+          first.ParentID() == second.ParentID() &&
+          first.StartOffset() == second.StartOffset() &&
+          first.EndOffset() == second.EndOffset() &&
+          first.StartTime() == second.StartTime() &&
+          first.EndTime() == second.EndTime() &&
+          first.ChannelID() == second.ChannelID() &&
+          first.Filter() == second.Filter() &&
+          first.Title() == second.Title();
+}
+
+// Compare the program fields shown by timers
+static bool SameTimer(const MythProgramInfo &first, const MythProgramInfo &second)
+{
+  return
+  first.Status() == second.Status() &&
+          first.StartTime() == second.StartTime() &&
+          first.EndTime() == second.EndTime() &&
+          first.RecordingStartTime() == second.RecordingStartTime() &&
+          first.ChannelID() == second.ChannelID() &&
+          first.Priority() == second.Priority() &&
+          first.Title() == second.Title() &&
+          first.Subtitle() == second.Subtitle() &&
+          first.Description() == second.Description() &&
+          first.Category() == second.Category();
+}
+
+unsigned MythScheduleManager::Update()
+{
+  {
+    CLockObject lock(m_lock);
+    // Setup VersionHelper for the new set
+    this->Setup();
+  }
 
-  // Setup VersionHelper for the new set
-  this->Setup();
+  // Fetch the new set before locking, then only diff it against the cache
   Myth::RecordScheduleListPtr records = m_control->GetRecordScheduleList();
-  m_rules.clear();
-  m_rulesById.clear();
-  m_templates.clear();
+  Myth::ProgramListPtr upcoming = m_control->GetUpcomingList();
+
+  CLockObject lock(m_lock);
+
+  NodeList rules;
+  NodeById rulesById;
+  TemplateRuleList templates;
+  std::set<uint32_t> changedRules;
   for (Myth::RecordScheduleList::iterator it = records->begin(); it != records->end(); ++it)
   {
     MythRecordingRule rule(*it);
     RecordingRuleNodePtr node = RecordingRuleNodePtr(new MythRecordingRuleNode(rule));
-    m_rules.push_back(node);
-    m_rulesById.insert(NodeById::value_type(rule.RecordID(), node));
+    rules.push_back(node);
+    rulesById.insert(NodeById::value_type(rule.RecordID(), node));
     if (node->GetRule().Type() == Myth::RT_TemplateRecord)
-      m_templates.push_back(node);
-  }
+      templates.push_back(node);
 
-  for (NodeList::iterator it = m_rules.begin(); it != m_rules.end(); ++it)
+    NodeById::const_iterator old = m_rulesById.find(rule.RecordID());
+    if (old == m_rulesById.end() || !SameTimerRule(old->second->m_rule, rule))
+      changedRules.insert(rule.RecordID());
+  }
+  for (NodeById::const_iterator it = m_rulesById.begin(); it != m_rulesById.end(); ++it)
+    if (rulesById.find(it->first) == rulesById.end())
+      changedRules.insert(it->first);
+
+  // An override rule lives in the timeslot of its main rule: same channel and
+  // same start time. Index main rules by timeslot to link the orphan overrides.
+  typedef std::multimap<std::pair<uint32_t, time_t>, RecordingRuleNodePtr> NodeByTimeslot;
+  NodeByTimeslot rulesByTimeslot;
+  for (NodeList::iterator it = rules.begin(); it != rules.end(); ++it)
+    if (!(*it)->IsOverrideRule())
+      rulesByTimeslot.insert(NodeByTimeslot::value_type(std::make_pair((*it)->m_rule.ChannelID(), (*it)->m_rule.StartTime()), *it));
+
+  for (NodeList::iterator it = rules.begin(); it != rules.end(); ++it)
     // Is override rule ? Then find main rule and link to it
     if ((*it)->IsOverrideRule())
     {
       // First check parentid. Then fallback searching the same timeslot
-      NodeById::iterator itp = m_rulesById.find((*it)->m_rule.ParentID());
-      if (itp != m_rulesById.end())
+      NodeById::iterator itp = rulesById.find((*it)->m_rule.ParentID());
+      if (itp != rulesById.end())
       {
         itp->second->m_overrideRules.push_back((*it)->m_rule);
         (*it)->m_mainRule = itp->second->m_rule;
       }
       else
       {
-        for (NodeList::iterator itm = m_rules.begin(); itm != m_rules.end(); ++itm)
-          if (!(*itm)->IsOverrideRule() && m_versionHelper->SameTimeslot((*it)->m_rule, (*itm)->m_rule))
+        std::pair<NodeByTimeslot::iterator, NodeByTimeslot::iterator> range =
+                rulesByTimeslot.equal_range(std::make_pair((*it)->m_rule.ChannelID(), (*it)->m_rule.StartTime()));
+        for (NodeByTimeslot::iterator itm = range.first; itm != range.second; ++itm)
+          if (m_versionHelper->SameTimeslot((*it)->m_rule, itm->second->m_rule))
           {
-            (*itm)->m_overrideRules.push_back((*it)->m_rule);
-            (*it)->m_mainRule = (*itm)->m_rule;
+            itm->second->m_overrideRules.push_back((*it)->m_rule);
+            (*it)->m_mainRule = itm->second->m_rule;
           }
-
       }
     }
 
-  m_recordings.clear();
-  m_recordingIndexByRuleId.clear();
+  RecordingList recordings;
+  RecordingIndexByRuleId recordingIndexByRuleId;
+  std::set<uint32_t> changed;
   // Add upcoming recordings
-  Myth::ProgramListPtr recordings = m_control->GetUpcomingList();
-  for (Myth::ProgramList::iterator it = recordings->begin(); it != recordings->end(); ++it)
+  for (Myth::ProgramList::iterator it = upcoming->begin(); it != upcoming->end(); ++it)
   {
     ScheduledPtr scheduled = ScheduledPtr(new MythProgramInfo(*it));
     uint32_t index = MakeIndex(scheduled);
-    m_recordings.insert(RecordingList::value_type(index, scheduled));
-    m_recordingIndexByRuleId.insert(RecordingIndexByRuleId::value_type(scheduled->RecordID(), index));
+    if (!recordings.insert(RecordingList::value_type(index, scheduled)).second)
+      continue;
+    recordingIndexByRuleId.insert(RecordingIndexByRuleId::value_type(scheduled->RecordID(), index));
+
+    RecordingList::const_iterator old = m_recordings.find(index);
+    if (old == m_recordings.end() || !SameTimer(*(old->second), *scheduled) || changedRules.count(scheduled->RecordID()))
+      changed.insert(index);
   }
+  for (RecordingList::const_iterator it = m_recordings.begin(); it != m_recordings.end(); ++it)
+    if (recordings.find(it->first) == recordings.end())
+      changed.insert(it->first);
 
   // Add missed programs (NOT RECORDING) to upcoming recordings. User could delete them as needed.
   /*
@@ -644,21 +708,27 @@ void MythScheduleManager::Update()
     Myth::ProgramList norec = m_control->???;
     for (Myth::ProgramList::iterator it = norec.begin(); it != norec.end(); ++it)
     {
-      if (m_recordingIndexByRuleId.count(it->second.RecordID()) == 0)
+      if (recordingIndexByRuleId.count(it->second.RecordID()) == 0)
       {
-        NodeById::const_iterator itr = m_rulesById.find(it->second.RecordID());
-        if (itr != m_rulesById.end() && !itr->second->HasOverrideRules())
+        NodeById::const_iterator itr = rulesById.find(it->second.RecordID());
+        if (itr != rulesById.end() && !itr->second->HasOverrideRules())
         {
           ScheduledPtr scheduled = ScheduledPtr(new MythProgramInfo(*it));
           uint32_t index = MakeIndex(scheduled);
-          m_recordings.insert(RecordingList::value_type(index, scheduled));
-          m_recordingIndexByRuleId.insert(RecordingIndexByRuleId::value_type(scheduled->RecordID(), index));
+          recordings.insert(RecordingList::value_type(index, scheduled));
+          recordingIndexByRuleId.insert(RecordingIndexByRuleId::value_type(scheduled->RecordID(), index));
         }
       }
     }
   }
   */
 
+  m_rules.swap(rules);
+  m_rulesById.swap(rulesById);
+  m_templates.swap(templates);
+  m_recordings.swap(recordings);
+  m_recordingIndexByRuleId.swap(recordingIndexByRuleId);
+
   if (g_bExtraDebug)
   {
     for (NodeList::iterator it = m_rules.begin(); it != m_rules.end(); ++it)
@@ -668,7 +738,11 @@ void MythScheduleManager::Update()
     for (RecordingList::iterator it = m_recordings.begin(); it != m_recordings.end(); ++it)
       XBMC->Log(LOG_DEBUG, "%s - Recording - recordid: %u, index: %u, status: %d, title: %s", __FUNCTION__,
               (unsigned)it->second->RecordID(), (unsigned)it->first, it->second->Status(), it->second->Title().c_str());
+    for (std::set<uint32_t>::const_iterator it = changed.begin(); it != changed.end(); ++it)
+      XBMC->Log(LOG_DEBUG, "%s - Changed - index: %u", __FUNCTION__, (unsigned)*it);
   }
+  XBMC->Log(LOG_DEBUG, "%s: %u rules changed, %u timers changed", __FUNCTION__, (unsigned)changedRules.size(), (unsigned)changed.size());
+  return (unsigned)changed.size();
 }
 
 RuleMetadata MythScheduleManager::GetMetadata(const MythRecordingRule &rule) const
@@ -29,6 +29,7 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <set>
 
 class MythRecordingRuleNode;
 typedef MYTH_SHARED_PTR<MythRecordingRuleNode> RecordingRuleNodePtr;
@@ -100,7 +101,8 @@ public:
 
   bool OpenControl();
   void CloseControl();
-  void Update();
+  // Refresh rules and upcoming recordings. Returns the count of timers changed
+  unsigned Update();
 
   class VersionHelper
   {
@@ -92,6 +92,7 @@ void ES_MPEG2Video::Parse(STREAM_PKT *pkt)
         break;
       }
     }
+    p = SkipToStartCode(es_buf, p, (int)es_len - 4, startcode);
     startcode = startcode << 8 | es_buf[p++];
   }
   es_parsed = p;
@@ -82,6 +82,7 @@ void ES_h264::Parse(STREAM_PKT* pkt)
         break;
       }
     }
+    p = SkipToStartCode(es_buf, p, (int)es_len - 4, startcode);
     startcode = startcode << 8 | es_buf[p++];
   }
   es_parsed = p;
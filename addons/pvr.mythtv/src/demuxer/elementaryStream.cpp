@@ -70,7 +70,11 @@ int ElementaryStream::Append(const unsigned char* buf, size_t len, bool new_pts)
 
   if (es_buf && es_consumed)
   {
-    if (es_consumed < es_len)
+    if (es_consumed >= es_len)
+      ClearBuffer();
+    // Parsers index the buffer from its start: the unconsumed data is moved
+    // down only when the tail has no more room, not on every append
+    else if (es_len + len > es_alloc)
     {
       memmove(es_buf, es_buf + es_consumed, es_len - es_consumed);
       es_len -= es_consumed;
@@ -82,8 +86,6 @@ int ElementaryStream::Append(const unsigned char* buf, size_t len, bool new_pts)
 
       es_consumed = 0;
     }
-    else
-      ClearBuffer();
   }
   if (es_len + len > es_alloc)
   {
@@ -180,10 +182,10 @@ void ElementaryStream::Parse(STREAM_PKT* pkt)
   // No parser: pass-through
   if (es_consumed < es_len)
   {
-    es_consumed = es_parsed = es_len;
     pkt->pid              = pid;
-    pkt->size             = es_consumed;
-    pkt->data             = es_buf;
+    pkt->size             = es_len - es_consumed;
+    pkt->data             = es_buf + es_consumed;
+    es_consumed = es_parsed = es_len;
     pkt->dts              = c_dts;
     pkt->pts              = c_pts;
     if (c_dts == PTS_UNSET || p_dts == PTS_UNSET)
@@ -205,6 +207,25 @@ void ElementaryStream::ResetStreamPacket(STREAM_PKT* pkt)
   pkt->streamChange       = false;
 }
 
+/*
+ * Start code parsers shift the buffer one byte at a time into startcode.
+ * A start code (00 00 01) can't complete before the next zero byte, unless one
+ * of the last three bytes shifted is zero. So jump to that zero byte, or to
+ * last, and reload startcode with the bytes preceding the new position.
+ * memchr is vectorized by the C library on SSE2 and NEON targets.
+ */
+int ElementaryStream::SkipToStartCode(const unsigned char* buf, int pos, int last, uint32_t& startcode)
+{
+  if (pos >= last || !(startcode & 0xff) || !(startcode & 0xff00) || !(startcode & 0xff0000))
+    return pos;
+
+  const unsigned char* zero = (const unsigned char*)memchr(buf + pos, 0, last - pos);
+  int next = zero ? (int)(zero - buf) : last;
+  for (int i = (next - 4 > pos ? next - 4 : pos); i < next; i++)
+    startcode = startcode << 8 | buf[i];
+  return next;
+}
+
 uint64_t ElementaryStream::Rescale(uint64_t a, uint64_t b, uint64_t c)
 {
   uint64_t r = c / 2;
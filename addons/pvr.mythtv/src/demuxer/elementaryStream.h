@@ -101,6 +101,7 @@ public:
 protected:
   void ResetStreamPacket(STREAM_PKT* pkt);
   uint64_t Rescale(uint64_t a, uint64_t b, uint64_t c);
+  static int SkipToStartCode(const unsigned char* buf, int pos, int last, uint32_t& startcode);
   bool SetVideoInformation(int FpsScale, int FpsRate, int Height, int Width, float Aspect, bool Interlaced);
   bool SetAudioInformation(int Channels, int SampleRate, int BitRate, int BitsPerSample, int BlockAlign);
 
@@ -0,0 +1,151 @@
+/*
+ *      Copyright (C) 2005-2014 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "guidecache.h"
+#include "client.h"
+
+#include <algorithm>
+
+#define GUIDECACHE_CHANNELS     100   // channels fetched per request
+#define GUIDECACHE_MARGIN       3600  // period fetched beyond the requested end
+#define GUIDECACHE_TTL          1800  // seconds before the guide is reloaded
+
+using namespace ADDON;
+using namespace PLATFORM;
+
+GuideCache::GuideCache(Myth::Control *control)
+: m_control(control)
+, m_generation(0)
+, m_startTime(0)
+, m_endTime(0)
+, m_loadTime(0)
+{
+}
+
+void GuideCache::SetChannels(const std::vector<uint32_t>& chanids)
+{
+  CLockObject lock(m_lock);
+  m_chanids = chanids;
+  std::sort(m_chanids.begin(), m_chanids.end());
+  m_chanids.erase(std::unique(m_chanids.begin(), m_chanids.end()), m_chanids.end());
+  m_guide.clear();
+  m_loadTime = 0;
+  ++m_generation;
+}
+
+void GuideCache::Invalidate()
+{
+  CLockObject lock(m_lock);
+  m_guide.clear();
+  m_loadTime = 0;
+  ++m_generation;
+}
+
+Myth::ProgramMapPtr GuideCache::GetProgramGuide(uint32_t chanid, time_t starttime, time_t endtime)
+{
+  Myth::ProgramMapPtr programs;
+  if (!Find(chanid, starttime, endtime, programs))
+  {
+    // One load at a time: the others wait for it rather than fetch the guide again
+    CLockObject lock(m_loadLock);
+    if (!Find(chanid, starttime, endtime, programs))
+    {
+      Load(starttime, endtime + GUIDECACHE_MARGIN);
+      Find(chanid, starttime, endtime, programs);
+    }
+  }
+  // Channel not covered by the bulk requests
+  if (!programs)
+    return m_control->GetProgramGuide(chanid, starttime, endtime);
+
+  Myth::ProgramMapPtr ret(new Myth::ProgramMap);
+  for (Myth::ProgramMap::const_iterator itp = programs->begin(); itp != programs->end(); ++itp)
+  {
+    if (itp->second->endTime >= starttime && itp->second->startTime <= endtime)
+      ret->insert(*itp);
+  }
+  return ret;
+}
+
+/*
+ * Returns false when the guide must be reloaded for the period. Otherwise
+ * sets the programs of the channel, or none if the channel isn't loaded.
+ */
+bool GuideCache::Find(uint32_t chanid, time_t starttime, time_t endtime, Myth::ProgramMapPtr& programs)
+{
+  CLockObject lock(m_lock);
+  if (starttime < m_startTime || endtime > m_endTime || time(NULL) > m_loadTime + GUIDECACHE_TTL)
+    return false;
+  Myth::ProgramGuideMap::const_iterator it = m_guide.find(chanid);
+  if (it != m_guide.end())
+    programs = it->second;
+  return true;
+}
+
+void GuideCache::Load(time_t starttime, time_t endtime)
+{
+  unsigned requests = 0;
+  std::vector<uint32_t> chanids;
+  unsigned generation;
+  {
+    CLockObject lock(m_lock);
+    chanids = m_chanids;
+    generation = m_generation;
+  }
+
+  // The requests run unlocked, so the cache keeps serving meanwhile
+  Myth::ProgramGuideMap loaded;
+  time_t loadTime = time(NULL);
+  for (size_t i = 0; i < chanids.size(); i += GUIDECACHE_CHANNELS)
+  {
+    size_t n = std::min<size_t>(GUIDECACHE_CHANNELS, chanids.size() - i);
+    Myth::ProgramGuideMapPtr guide = m_control->GetProgramGuide(chanids[i], (unsigned)n, starttime, endtime);
+    ++requests;
+    if (guide->empty())
+      continue;
+    /*
+     * The backend returns the channels having programs in the period. Those of
+     * the range below the last one returned have none. The others are left to
+     * a request of their own.
+     */
+    uint32_t last = guide->rbegin()->first;
+    for (size_t j = i; j < i + n; ++j)
+    {
+      Myth::ProgramGuideMap::iterator it = guide->find(chanids[j]);
+      if (it != guide->end())
+        loaded.insert(*it);
+      else if (chanids[j] < last)
+        loaded.insert(std::make_pair(chanids[j], Myth::ProgramMapPtr(new Myth::ProgramMap)));
+    }
+  }
+  XBMC->Log(LOG_DEBUG, "%s: loaded %u of %u channels in %u requests", __FUNCTION__,
+            (unsigned)loaded.size(), (unsigned)chanids.size(), requests);
+
+  CLockObject lock(m_lock);
+  // Channels changed or guide invalidated while loading: the result is stale
+  if (generation != m_generation)
+    return;
+  m_guide.swap(loaded);
+  m_startTime = starttime;
+  m_endTime = endtime;
+  m_loadTime = loadTime;
+}
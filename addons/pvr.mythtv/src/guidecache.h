@@ -0,0 +1,60 @@
+#pragma once
+/*
+ *      Copyright (C) 2005-2014 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <mythcontrol.h>
+#include <platform/threads/mutex.h>
+
+#include <vector>
+#include <time.h>
+
+/**
+ * Fetches the guide of all channels with few Guide/GetProgramGuide requests,
+ * each covering a range of channels, and serves it channel by channel until
+ * the guide gets old or a period outside the loaded one is requested.
+ */
+class GuideCache
+{
+public:
+  GuideCache(Myth::Control *control);
+
+  // Set the channels to fetch in bulk
+  void SetChannels(const std::vector<uint32_t>& chanids);
+  // Get the programs of the channel in the time period
+  Myth::ProgramMapPtr GetProgramGuide(uint32_t chanid, time_t starttime, time_t endtime);
+  // Drop the loaded guide. Next call reloads it
+  void Invalidate();
+
+private:
+  bool Find(uint32_t chanid, time_t starttime, time_t endtime, Myth::ProgramMapPtr& programs);
+  void Load(time_t starttime, time_t endtime);
+
+  Myth::Control *m_control;
+  PLATFORM::CMutex m_lock;
+  PLATFORM::CMutex m_loadLock;
+  std::vector<uint32_t> m_chanids;
+  unsigned m_generation;
+  Myth::ProgramGuideMap m_guide;
+  time_t m_startTime;
+  time_t m_endTime;
+  time_t m_loadTime;
+};
@@ -23,7 +23,6 @@
 #include "pvrclient-mythtv.h"
 #include "client.h"
 #include "tools.h"
-#include "avinfo.h"
 #include "guidialogyesno.h"
 
 #include <time.h>
@@ -41,6 +40,8 @@ PVRClientMythTV::PVRClientMythTV()
 , m_hang(false)
 , m_powerSaving(false)
 , m_fileOps(NULL)
+, m_avInfoCache(NULL)
+, m_guideCache(NULL)
 , m_scheduleManager(NULL)
 , m_categories()
 , m_channelGroups()
@@ -53,6 +54,8 @@ PVRClientMythTV::~PVRClientMythTV()
 {
   SAFE_DELETE(m_demux);
   SAFE_DELETE(m_fileOps);
+  SAFE_DELETE(m_avInfoCache);
+  SAFE_DELETE(m_guideCache);
   SAFE_DELETE(m_scheduleManager);
   SAFE_DELETE(m_eventHandler);
   SAFE_DELETE(m_control);
@@ -122,11 +125,14 @@ bool PVRClientMythTV::Connect()
   // Create event handler
   m_eventHandler = new Myth::EventHandler(g_szMythHostname, g_iProtoPort);
   m_eventSubscriberId = m_eventHandler->CreateSubscription(this);
+  // Bursts of schedule changes and timer ticks are handled once
+  m_eventHandler->SetCoalescing(m_eventSubscriberId, true);
   m_eventHandler->SubscribeForEvent(m_eventSubscriberId, Myth::EVENT_HANDLER_STATUS);
   m_eventHandler->SubscribeForEvent(m_eventSubscriberId, Myth::EVENT_HANDLER_TIMER);
   m_eventHandler->SubscribeForEvent(m_eventSubscriberId, Myth::EVENT_SCHEDULE_CHANGE);
   m_eventHandler->SubscribeForEvent(m_eventSubscriberId, Myth::EVENT_ASK_RECORDING);
   m_eventHandler->SubscribeForEvent(m_eventSubscriberId, Myth::EVENT_RECORDING_LIST_CHANGE);
+  m_eventHandler->SubscribeForEvent(m_eventSubscriberId, Myth::EVENT_SYSTEM_EVENT);
 
   // Create schedule manager
   m_scheduleManager = new MythScheduleManager(g_szMythHostname, g_iProtoPort, g_iWSApiPort);
@@ -134,6 +140,12 @@ bool PVRClientMythTV::Connect()
   // Create file operation helper (image caching)
   m_fileOps = new FileOps(g_szMythHostname, g_iWSApiPort);
 
+  // Create AV info cache of recordings
+  m_avInfoCache = new AVInfoCache(g_szMythHostname, g_iProtoPort);
+
+  // Create guide cache for bulk EPG transfer
+  m_guideCache = new GuideCache(m_control);
+
   // Start event handler
   m_eventHandler->Start();
   return true;
@@ -185,6 +197,8 @@ void PVRClientMythTV::OnSleep()
 {
   if (m_fileOps)
     m_fileOps->Suspend();
+  if (m_avInfoCache)
+    m_avInfoCache->Suspend();
   if (m_eventHandler)
     m_eventHandler->Stop();
   if (m_scheduleManager)
@@ -203,6 +217,8 @@ void PVRClientMythTV::OnWake()
     m_eventHandler->Start();
   if (m_fileOps)
     m_fileOps->Resume();
+  if (m_avInfoCache)
+    m_avInfoCache->Resume();
 }
 
 void PVRClientMythTV::OnDeactivatedGUI()
@@ -232,6 +248,11 @@ void PVRClientMythTV::HandleBackendMessage(const Myth::EventMessage& msg)
     case Myth::EVENT_RECORDING_LIST_CHANGE:
       HandleRecordingListChange(msg);
       break;
+    case Myth::EVENT_SYSTEM_EVENT:
+      // The guide data has been refreshed
+      if (msg.subject.size() > 1 && msg.subject[1] == "MYTHFILLDATABASE_RAN" && m_guideCache)
+        m_guideCache->Invalidate();
+      break;
     case Myth::EVENT_HANDLER_TIMER:
       RunHouseKeeping();
       break;
@@ -257,6 +278,8 @@ void PVRClientMythTV::HandleBackendMessage(const Myth::EventMessage& msg)
           XBMC->QueueNotification(QUEUE_INFO, XBMC->GetLocalizedString(30303)); // Connection to MythTV restored
         }
         // Refreshing all
+        if (m_guideCache)
+          m_guideCache->Invalidate();
         HandleScheduleChange();
         HandleRecordingListChange(Myth::EventMessage());
       }
@@ -276,8 +299,9 @@ void PVRClientMythTV::HandleScheduleChange()
 {
   if (!m_scheduleManager)
     return;
-  m_scheduleManager->Update();
-  PVR->TriggerTimerUpdate();
+  // Tell XBMC only if timers have changed
+  if (m_scheduleManager->Update())
+    PVR->TriggerTimerUpdate();
 }
 
 void PVRClientMythTV::HandleAskRecording(const Myth::EventMessage& msg)
@@ -423,7 +447,15 @@ PVR_ERROR PVRClientMythTV::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANN
 
   if (!channel.bIsHidden)
   {
-    Myth::ProgramMapPtr EPG = m_control->GetProgramGuide(channel.iUniqueId, iStart, iEnd);
+    Myth::ProgramMapPtr EPG = m_guideCache->GetProgramGuide(channel.iUniqueId, iStart, iEnd);
+    // Successive programs mostly share channel, category and rating: parse
+    // and look them up only when they change
+    uint32_t chanId = 0;
+    int chanNum = 0;
+    const std::string *category = NULL;
+    int genre = 0;
+    const std::string *stars = NULL;
+    int starRating = 0;
     // Transfer EPG for the given channel
     for (Myth::ProgramMap::reverse_iterator it = EPG->rbegin(); it != EPG->rend(); ++it)
     {
@@ -442,8 +474,17 @@ PVR_ERROR PVRClientMythTV::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANN
       tag.strPlot = it->second->description.c_str();
       tag.strGenreDescription = it->second->category.c_str();
       tag.iUniqueBroadcastId = MakeBroadcastID(it->second->channel.chanId, it->first);
-      tag.iChannelNumber = atoi(it->second->channel.chanNum.c_str());
-      int genre = m_categories.Category(it->second->category);
+      if (!chanId || it->second->channel.chanId != chanId)
+      {
+        chanId = it->second->channel.chanId;
+        chanNum = atoi(it->second->channel.chanNum.c_str());
+      }
+      tag.iChannelNumber = chanNum;
+      if (!category || it->second->category != *category)
+      {
+        category = &(it->second->category);
+        genre = m_categories.Category(*category);
+      }
       tag.iGenreSubType = genre & 0x0F;
       tag.iGenreType = genre & 0xF0;
       tag.strEpisodeName = "";
@@ -455,7 +496,12 @@ PVR_ERROR PVRClientMythTV::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANN
       tag.iEpisodePartNumber = 0;
       tag.iParentalRating = 0;
       tag.iSeriesNumber = (int)it->second->season;
-      tag.iStarRating = atoi(it->second->stars.c_str());
+      if (!stars || it->second->stars != *stars)
+      {
+        stars = &(it->second->stars);
+        starRating = atoi(stars->c_str());
+      }
+      tag.iStarRating = starRating;
 
       PVR->TransferEpgEntry(handle, &tag);
     }
@@ -637,6 +683,15 @@ void PVRClientMythTV::LoadChannelsAndChannelGroups()
     }
     m_channelGroups.insert(std::make_pair((*its)->sourceName, channelIDs));
   }
+
+  // Fetch the guide of visible channels in bulk
+  std::vector<uint32_t> guideIDs;
+  for (ChannelIdMap::const_iterator it = m_channelsById.begin(); it != m_channelsById.end(); ++it)
+  {
+    if (it->second.Visible())
+      guideIDs.push_back(it->first);
+  }
+  m_guideCache->SetChannels(guideIDs);
 }
 
 int PVRClientMythTV::FindPVRChannelUid(uint32_t channelId) const
@@ -821,7 +876,13 @@ int PVRClientMythTV::FillRecordings()
     m_recordings.insert(std::make_pair(prog.UID(), prog));
     // Count visible recordings
     if (prog.IsVisible() && !prog.IsLiveTV())
+    {
       ++count;
+      // Get AV info from cache, else probe it in background. Only the master
+      // backend is probed, other recordings are probed on opening.
+      if (!m_avInfoCache->Lookup(prog) && prog.HostName() == m_control->GetServerHostName())
+        m_avInfoCache->Queue(prog);
+    }
   }
   return count;
 }
@@ -1062,8 +1123,10 @@ PVR_ERROR PVRClientMythTV::GetRecordingEdl(const PVR_RECORDING &recording, PVR_E
     }
     prog = it->second;
   }
-  // Check required props else return
+  // Check required props else return. The background prober may have cached them since
   float fps = prog.GetPropsVideoFrameRate();
+  if (fps <= 0 && m_avInfoCache->Lookup(prog))
+    fps = prog.GetPropsVideoFrameRate();
   XBMC->Log(LOG_DEBUG, "%s: AV props: Frame Rate = %.3f", __FUNCTION__, fps);
   if (fps <= 0)
     return PVR_ERROR_NO_ERROR;
@@ -1595,8 +1658,11 @@ bool PVRClientMythTV::OpenLiveStream(const PVR_CHANNEL &channel)
     return false;
   // Suspend fileOps to avoid connection hang
   m_fileOps->Suspend();
+  m_avInfoCache->Suspend();
   // Set tuning delay
   m_liveStream->SetTuneDelay(g_iTuneDelay);
+  // Set read-ahead buffer of the chained files
+  m_liveStream->SetBufferSize((unsigned)g_iLiveTVBuffer * 1024 * 1024);
   // Try to open
   if (m_liveStream->SpawnLiveTV(*chan))
   {
@@ -1609,6 +1675,7 @@ bool PVRClientMythTV::OpenLiveStream(const PVR_CHANNEL &channel)
   SAFE_DELETE(m_liveStream);
   // Resume fileOps
   m_fileOps->Resume();
+  m_avInfoCache->Resume();
   XBMC->Log(LOG_ERROR,"%s: Failed to open live stream", __FUNCTION__);
   XBMC->QueueNotification(QUEUE_WARNING, XBMC->GetLocalizedString(30305)); // Channel unavailable
   return false;
@@ -1629,6 +1696,7 @@ void PVRClientMythTV::CloseLiveStream()
     SAFE_DELETE(m_liveStream);
   // Resume fileOps
   m_fileOps->Resume();
+  m_avInfoCache->Resume();
 
   if (g_bExtraDebug)
     XBMC->Log(LOG_DEBUG, "%s: Done", __FUNCTION__);
@@ -1839,6 +1907,7 @@ bool PVRClientMythTV::OpenRecordedStream(const PVR_RECORDING &recording)
   CLockObject lock(m_lock);
   // Suspend fileOps to avoid connection hang
   m_fileOps->Suspend();
+  m_avInfoCache->Suspend();
 
   if (!m_recordingStream)
   {
@@ -1871,14 +1940,16 @@ bool PVRClientMythTV::OpenRecordedStream(const PVR_RECORDING &recording)
   {
     if (g_bExtraDebug)
       XBMC->Log(LOG_DEBUG, "%s: Done", __FUNCTION__);
-    // Fill AV info for later use
-    FillRecordingAVInfo(prog, m_recordingStream);
+    // Fill AV info for later use: probe the stream only if not cached
+    if (!m_avInfoCache->Lookup(prog))
+      m_avInfoCache->Probe(prog, m_recordingStream);
     return true;
   }
 
   SAFE_DELETE(m_recordingStream);
   // Resume fileOps
   m_fileOps->Resume();
+  m_avInfoCache->Resume();
   XBMC->Log(LOG_ERROR,"%s: Failed to open recorded stream", __FUNCTION__);
   return false;
 }
@@ -1894,6 +1965,7 @@ void PVRClientMythTV::CloseRecordedStream()
   SAFE_DELETE(m_recordingStream);
   // Resume fileOps
   m_fileOps->Resume();
+  m_avInfoCache->Resume();
 
   if (g_bExtraDebug)
     XBMC->Log(LOG_DEBUG, "%s: Done", __FUNCTION__);
@@ -2134,28 +2206,3 @@ void PVRClientMythTV::BreakBroadcastID(int broadcastid, unsigned int *chanid, ti
   *attime = mktime(&epgtm);
   *chanid = (unsigned int)broadcastid & 0xFFFF;
 }
-
-void PVRClientMythTV::FillRecordingAVInfo(MythProgramInfo& programInfo, Myth::Stream *stream)
-{
-  AVInfo info(stream);
-  AVInfo::STREAM_AVINFO mInfo;
-  if (info.GetMainStream(&mInfo))
-  {
-    // Set video frame rate
-    if (mInfo.stream_info.fps_scale > 0)
-    {
-      float fps = 0;
-      switch(mInfo.stream_type)
-      {
-        case STREAM_TYPE_VIDEO_H264:
-          fps = (float)(mInfo.stream_info.fps_rate) / (mInfo.stream_info.fps_scale * (mInfo.stream_info.interlaced ? 2 : 1));
-          break;
-        default:
-          fps = (float)(mInfo.stream_info.fps_rate) / mInfo.stream_info.fps_scale;
-      }
-      programInfo.SetPropsVideoFrameRate(fps);
-    }
-    // Set video aspec
-    programInfo.SetPropsVideoAspec(mInfo.stream_info.aspect);
-  }
-}
@@ -23,6 +23,8 @@
 
 #include "cppmyth.h"
 #include "fileOps.h"
+#include "avinfocache.h"
+#include "guidecache.h"
 #include "categories.h"
 #include "demux.h"
 
@@ -141,6 +143,8 @@ private:
 
   // Backend
   FileOps *m_fileOps;
+  AVInfoCache *m_avInfoCache;
+  GuideCache *m_guideCache;
   MythScheduleManager *m_scheduleManager;
   PLATFORM::CMutex m_lock;
 
@@ -189,10 +193,4 @@ private:
    */
   static int MakeBroadcastID(unsigned int chanid, time_t starttime);
   static void BreakBroadcastID(int broadcastid, unsigned int *chanid, time_t *starttime);
-
-  /**
-   *
-   * \brief Parse and fill AV stream infos for a recorded program
-   */
-  static void FillRecordingAVInfo(MythProgramInfo& programInfo, Myth::Stream *stream);
 };
@@ -0,0 +1,367 @@
+/*
+ *      Copyright (C) 2005-2011 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301  USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "platform/os.h"
+#include "platform/util/timeutils.h"
+
+#include "client.h"
+#include "IconCache.h"
+#include "Socket.h"
+
+using namespace ADDON;
+using namespace PLATFORM;
+
+#define ICON_DOWNLOAD_TIMEOUT 20000   // ms without data before a download is given up
+#define ICON_READ_BLOCK_SIZE  32768
+
+void *cIconCacheWorker::Process(void)
+{
+  int iChannelId;
+
+  while (!IsStopped() && m_cache.NextJob(iChannelId))
+  {
+    bool bChanged = false;
+    bool bSuccess = m_cache.Download(iChannelId, *this, bChanged);
+    m_cache.JobDone(iChannelId, bSuccess, bChanged);
+  }
+
+  return NULL;
+}
+
+cIconCache::cIconCache(unsigned int iWorkers) :
+  m_strIconPath(g_szUserPath),
+  m_bCancelled(false),
+  m_bChanged(false),
+  m_iRunning(0),
+  m_iDownloaded(0),
+  m_iNotModified(0),
+  m_iFailed(0)
+{
+  if (!m_strIconPath.empty() && m_strIconPath[m_strIconPath.length() - 1] != '/' && m_strIconPath[m_strIconPath.length() - 1] != '\\')
+    m_strIconPath += PATH_SEPARATOR_CHAR;
+
+  if (!XBMC->DirectoryExists(m_strIconPath.c_str()) && !XBMC->CreateDirectory(m_strIconPath.c_str()))
+    XBMC->Log(LOG_ERROR, "%s - Failed to create icon directory %s", __FUNCTION__, m_strIconPath.c_str());
+
+  for (unsigned int i = 0; i < iWorkers; i++)
+    m_workers.push_back(new cIconCacheWorker(*this));
+}
+
+cIconCache::~cIconCache(void)
+{
+  Cancel();
+
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+    delete m_workers[i];
+  m_workers.clear();
+}
+
+std::string cIconCache::IconFile(int iChannelId) const
+{
+  char filename[64];
+  snprintf(filename, sizeof(filename), "nextpvr-ch%d.png", iChannelId);
+  return m_strIconPath + filename;
+}
+
+std::string cIconCache::GetIconPath(int iChannelId)
+{
+  std::string strFile = IconFile(iChannelId);
+
+  CLockObject lock(m_mutex);
+
+  if (m_bCancelled)
+    return strFile;
+
+  std::map<int, ICON_STATE>::iterator it = m_icons.find(iChannelId);
+  if (it != m_icons.end() && it->second != ICON_FAILED)
+    return strFile;
+
+  // missing icons go first, cached ones are only revalidated
+  m_icons[iChannelId] = ICON_QUEUED;
+  if (XBMC->FileExists(strFile.c_str(), false))
+    m_queue.push_back(iChannelId);
+  else
+    m_queue.push_front(iChannelId);
+
+  // the workers are started with the first request and stay idle in between
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+  {
+    if (!m_workers[i]->IsRunning())
+      m_workers[i]->CreateThread(false);
+  }
+
+  m_jobQueued.Signal();
+
+  return strFile;
+}
+
+void cIconCache::Cancel(void)
+{
+  {
+    CLockObject lock(m_mutex);
+    m_bCancelled = true;
+    m_queue.clear();
+    m_jobQueued.Broadcast();
+  }
+
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+    m_workers[i]->StopThread();
+}
+
+bool cIconCache::NextJob(int &iChannelId)
+{
+  CLockObject lock(m_mutex);
+
+  while (m_queue.empty())
+  {
+    if (m_bCancelled)
+      return false;
+    m_jobQueued.Wait(m_mutex, 1000);
+  }
+
+  if (m_bCancelled)
+    return false;
+
+  iChannelId = m_queue.front();
+  m_queue.pop_front();
+  m_icons[iChannelId] = ICON_RUNNING;
+  m_iRunning++;
+
+  return true;
+}
+
+void cIconCache::JobDone(int iChannelId, bool bSuccess, bool bChanged)
+{
+  bool bTriggerUpdate = false;
+  {
+    CLockObject lock(m_mutex);
+
+    m_icons[iChannelId] = bSuccess ? ICON_DONE : ICON_FAILED;
+    m_iRunning--;
+    if (!bSuccess)
+      m_iFailed++;
+    else if (bChanged)
+      m_iDownloaded++;
+    else
+      m_iNotModified++;
+    m_bChanged |= bChanged;
+
+    if (m_queue.empty() && m_iRunning == 0 && !m_bCancelled)
+    {
+      XBMC->Log(LOG_DEBUG, "%s - %d icons downloaded, %d not modified, %d failed", __FUNCTION__, m_iDownloaded, m_iNotModified, m_iFailed);
+      bTriggerUpdate = m_bChanged;
+      m_bChanged = false;
+      m_iDownloaded = m_iNotModified = m_iFailed = 0;
+    }
+  }
+
+  // let XBMC pick up the icons that weren't there when it listed the channels
+  if (bTriggerUpdate)
+    PVR->TriggerChannelUpdate();
+}
+
+bool cIconCache::Download(int iChannelId, CThread &worker, bool &bChanged)
+{
+  std::string strFile = IconFile(iChannelId);
+  std::string strMetaFile = strFile + ".meta";
+  std::string strETag, strLastModified;
+
+  if (XBMC->FileExists(strFile.c_str(), false))
+    LoadValidators(strMetaFile, strETag, strLastModified);
+
+  NextPVR::Socket socket(NextPVR::af_inet, NextPVR::pf_inet, NextPVR::sock_stream, NextPVR::tcp);
+  if (!socket.create() || !socket.connect(g_szHostname, g_iPort))
+  {
+    XBMC->Log(LOG_DEBUG, "%s - could not connect for the icon of channel %d", __FUNCTION__, iChannelId);
+    return false;
+  }
+
+  char line[256];
+  std::string strRequest;
+  snprintf(line, sizeof(line), "GET /service?method=channel.icon&channel_id=%d HTTP/1.0\r\n", iChannelId);
+  strRequest += line;
+  snprintf(line, sizeof(line), "Host: %s:%d\r\n", g_szHostname.c_str(), g_iPort);
+  strRequest += line;
+  if (!strETag.empty())
+    strRequest += "If-None-Match: " + strETag + "\r\n";
+  if (!strLastModified.empty())
+    strRequest += "If-Modified-Since: " + strLastModified + "\r\n";
+  strRequest += "Connection: close\r\n\r\n";
+  socket.send(strRequest);
+
+  std::string strResponse;
+  CTimeout timeout(ICON_DOWNLOAD_TIMEOUT);
+  char buffer[ICON_READ_BLOCK_SIZE];
+  while (true)
+  {
+    if (worker.IsStopped())
+    {
+      socket.close();
+      return false;
+    }
+    if (!socket.read_ready())
+    {
+      if (timeout.TimeLeft() == 0)
+      {
+        XBMC->Log(LOG_DEBUG, "%s - timed out reading the icon of channel %d", __FUNCTION__, iChannelId);
+        socket.close();
+        return false;
+      }
+      continue;
+    }
+
+    int read = socket.receive(buffer, sizeof(buffer), 0);
+    if (read <= 0)
+      break;
+    strResponse.append(buffer, read);
+    timeout.Init(ICON_DOWNLOAD_TIMEOUT);
+  }
+  socket.close();
+
+  size_t iHeaderEnd = strResponse.find("\r\n\r\n");
+  size_t iStatusPos = strResponse.find(' ');
+  if (strResponse.compare(0, 5, "HTTP/") != 0 || iHeaderEnd == std::string::npos || iStatusPos > iHeaderEnd)
+  {
+    XBMC->Log(LOG_DEBUG, "%s - invalid response for the icon of channel %d", __FUNCTION__, iChannelId);
+    return false;
+  }
+
+  int iStatus = atoi(strResponse.c_str() + iStatusPos);
+  if (iStatus == 304)
+    return true;
+
+  size_t iBodySize = strResponse.length() - (iHeaderEnd + 4);
+  if (iStatus != 200 || iBodySize == 0)
+  {
+    XBMC->Log(LOG_DEBUG, "%s - no icon for channel %d (status %d)", __FUNCTION__, iChannelId, iStatus);
+    return false;
+  }
+
+  // write the icon next to its final name and move it into place once it's
+  // complete, XBMC may load the file at any time
+  std::string strTempFile = strFile + ".tmp";
+  void *fileHandle = XBMC->OpenFileForWrite(strTempFile.c_str(), true);
+  if (fileHandle == NULL)
+  {
+    XBMC->Log(LOG_ERROR, "%s - failed to create %s", __FUNCTION__, strTempFile.c_str());
+    return false;
+  }
+  int written = XBMC->WriteFile(fileHandle, strResponse.c_str() + iHeaderEnd + 4, iBodySize);
+  XBMC->CloseFile(fileHandle);
+
+  if (written != (int)iBodySize || !ReplaceFile(strTempFile, strFile))
+  {
+    XBMC->Log(LOG_ERROR, "%s - failed to write %s", __FUNCTION__, strFile.c_str());
+    XBMC->DeleteFile(strTempFile.c_str());
+    return false;
+  }
+
+  std::string strHeaders = strResponse.substr(0, iHeaderEnd + 2);
+  SaveValidators(strMetaFile, HeaderValue(strHeaders, "ETag"), HeaderValue(strHeaders, "Last-Modified"));
+
+  bChanged = true;
+  return true;
+}
+
+/* The validators are kept as HTTP header lines, so they can be read back with HeaderValue() */
+void cIconCache::LoadValidators(const std::string &strFile, std::string &strETag, std::string &strLastModified)
+{
+  void *fileHandle = XBMC->OpenFile(strFile.c_str(), 0);
+  if (fileHandle == NULL)
+    return;
+
+  std::string strHeaders;
+  char buffer[1024];
+  unsigned int read;
+  while ((read = XBMC->ReadFile(fileHandle, buffer, sizeof(buffer))) > 0)
+    strHeaders.append(buffer, read);
+  XBMC->CloseFile(fileHandle);
+
+  strETag = HeaderValue(strHeaders, "ETag");
+  strLastModified = HeaderValue(strHeaders, "Last-Modified");
+}
+
+void cIconCache::SaveValidators(const std::string &strFile, const std::string &strETag, const std::string &strLastModified)
+{
+  if (strETag.empty() && strLastModified.empty())
+  {
+    XBMC->DeleteFile(strFile.c_str());
+    return;
+  }
+
+  std::string strHeaders;
+  if (!strETag.empty())
+    strHeaders += "ETag: " + strETag + "\r\n";
+  if (!strLastModified.empty())
+    strHeaders += "Last-Modified: " + strLastModified + "\r\n";
+
+  void *fileHandle = XBMC->OpenFileForWrite(strFile.c_str(), true);
+  if (fileHandle == NULL)
+    return;
+  XBMC->WriteFile(fileHandle, strHeaders.c_str(), strHeaders.length());
+  XBMC->CloseFile(fileHandle);
+}
+
+bool cIconCache::ReplaceFile(const std::string &strFrom, const std::string &strTo)
+{
+#if defined(TARGET_WINDOWS)
+  return MoveFileExA(strFrom.c_str(), strTo.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return rename(strFrom.c_str(), strTo.c_str()) == 0;
+#endif
+}
+
+std::string cIconCache::HeaderValue(const std::string &strHeaders, const char *strName)
+{
+  size_t iNameLen = strlen(strName);
+  size_t iPos = 0;
+
+  while (iPos < strHeaders.length())
+  {
+    size_t iEnd = strHeaders.find("\r\n", iPos);
+    if (iEnd == std::string::npos)
+      iEnd = strHeaders.length();
+
+    if (iEnd - iPos > iNameLen && strHeaders[iPos + iNameLen] == ':')
+    {
+      size_t i = 0;
+      while (i < iNameLen && tolower(strHeaders[iPos + i]) == tolower(strName[i]))
+        i++;
+
+      if (i == iNameLen)
+      {
+        size_t iValue = strHeaders.find_first_not_of(" \t", iPos + iNameLen + 1);
+        if (iValue == std::string::npos || iValue >= iEnd)
+          return "";
+        return strHeaders.substr(iValue, iEnd - iValue);
+      }
+    }
+
+    iPos = iEnd + 2;
+  }
+
+  return "";
+}
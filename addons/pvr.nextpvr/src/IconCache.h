@@ -0,0 +1,98 @@
+#pragma once
+/*
+ *      Copyright (C) 2005-2011 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301  USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include "platform/threads/threads.h"
+
+#define ICON_CACHE_WORKERS 4
+
+class cIconCache;
+
+class cIconCacheWorker : public PLATFORM::CThread
+{
+public:
+  cIconCacheWorker(cIconCache &cache) : m_cache(cache) {};
+  ~cIconCacheWorker(void) {};
+
+protected:
+  virtual void *Process(void);
+
+private:
+  cIconCache &m_cache;
+};
+
+/*
+ * Keeps the channel icons in the addon data directory up to date. Icons are
+ * downloaded on a small pool of worker threads, each with its own connection
+ * to the backend, so channel enumeration never waits for them. Icons that are
+ * already cached are revalidated once per session with a conditional request.
+ */
+class cIconCache
+{
+  friend class cIconCacheWorker;
+
+public:
+  cIconCache(unsigned int iWorkers = ICON_CACHE_WORKERS);
+  ~cIconCache(void);
+
+  /* Returns the local path of the channel's icon and queues its download. The
+   * file only shows up at that path once it has been completely written */
+  std::string GetIconPath(int iChannelId);
+  void Cancel(void);
+
+private:
+  typedef enum ICON_STATE
+  {
+    ICON_QUEUED,
+    ICON_RUNNING,
+    ICON_DONE,
+    ICON_FAILED
+  } ICON_STATE;
+
+  bool NextJob(int &iChannelId);
+  void JobDone(int iChannelId, bool bSuccess, bool bChanged);
+  bool Download(int iChannelId, PLATFORM::CThread &worker, bool &bChanged);
+
+  std::string IconFile(int iChannelId) const;
+  void LoadValidators(const std::string &strFile, std::string &strETag, std::string &strLastModified);
+  void SaveValidators(const std::string &strFile, const std::string &strETag, const std::string &strLastModified);
+  static bool ReplaceFile(const std::string &strFrom, const std::string &strTo);
+  static std::string HeaderValue(const std::string &strHeaders, const char *strName);
+
+  std::string m_strIconPath;
+  std::vector<cIconCacheWorker*> m_workers;
+  std::deque<int> m_queue;
+  std::map<int, ICON_STATE> m_icons;
+  bool m_bCancelled;
+  bool m_bChanged;
+  int m_iRunning;
+  int m_iDownloaded;
+  int m_iNotModified;
+  int m_iFailed;
+
+  PLATFORM::CMutex m_mutex;
+  PLATFORM::CCondition<bool> m_jobQueued;
+};
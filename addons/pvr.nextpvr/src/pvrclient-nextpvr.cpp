@@ -50,6 +50,9 @@ int g_iNextPVRXBMCBuild = 0;
 #define HTTP_OK 200
 #define HTTP_NOTFOUND 404
 
+#define HTTP_READ_BLOCK_SIZE  32768   // bytes read from the response body at once
+#define RESPONSE_CACHE_TTL    10000   // ms a list response is reused
+
 
 const char SAFE[256] =
 {
@@ -116,6 +119,10 @@ cPVRClientNextPVR::cPVRClientNextPVR()
   m_streamingclient        = new NextPVR::Socket(NextPVR::af_inet, NextPVR::pf_inet, NextPVR::sock_stream, NextPVR::tcp);
   m_bConnected             = false;
   m_iChannelCount          = 0;
+  m_iCacheGeneration       = 0;
+  m_iRequests              = 0;
+  m_iCachedRequests        = 0;
+  m_iRequestTime           = 0;
   m_currentRecordingLength = 0;
 
   m_supportsLiveTimeshift  = false;
@@ -123,6 +130,7 @@ cPVRClientNextPVR::cPVRClientNextPVR()
   m_currentLivePosition    = 0;
 
   m_pLiveShiftSource       = NULL;
+  m_pIconCache             = new cIconCache();
 
   m_incomingStreamBuffer.Create(188*2000);
 }
@@ -132,6 +140,7 @@ cPVRClientNextPVR::~cPVRClientNextPVR()
   XBMC->Log(LOG_DEBUG, "->~cPVRClientNextPVR()");
   if (m_bConnected)
     Disconnect();
+  SAFE_DELETE(m_pIconCache);
   SAFE_DELETE(m_tcpclient);  
 }
 
@@ -258,6 +267,10 @@ void cPVRClientNextPVR::Disconnect()
 {
   string result;
 
+  PLATFORM::CLockObject lock(m_mutex);
+  XBMC->Log(LOG_DEBUG, "%d requests (%lld ms), %d more served from the response cache", m_iRequests, (long long)m_iRequestTime, m_iCachedRequests);
+  InvalidateResponseCache();
+
   m_bConnected = false;
 }
 
@@ -427,105 +440,16 @@ int cPVRClientNextPVR::GetNumChannels(void)
     return m_iChannelCount;
 
 
-  // need something more optimal, but this will do for now...
   m_iChannelCount = 0;
   CStdString response;
   if (DoRequest("/service?method=channel.list", response) == HTTP_OK)
   {
-    TiXmlDocument doc;
-    if (doc.Parse(response) != NULL)
-    {
-      TiXmlElement* channelsNode = doc.RootElement()->FirstChildElement("channels");
-      TiXmlElement* pChannelNode;
-      for( pChannelNode = channelsNode->FirstChildElement("channel"); pChannelNode; pChannelNode=pChannelNode->NextSiblingElement())
-      {
-        m_iChannelCount++;
-      }
-    }
+    m_iChannelCount = CountElements(response, "channel");
   }
 
   return m_iChannelCount;
 }
 
-CStdString cPVRClientNextPVR::GetChannelIcon(int channelID)
-{
-  char filename[64];
-  snprintf(filename, sizeof(filename), "nextpvr-ch%d.png", channelID);
-
-  CStdString iconFilename("special://userdata/addon_data/pvr.nextpvr/");
-  iconFilename += filename;
-
-  // do we already have the icon file?
-  if (XBMC->FileExists(iconFilename, false))
-  {        
-    return iconFilename;    
-  } 
-
-  if (m_tcpclient->create())
-  {
-    if (m_tcpclient->connect(g_szHostname, g_iPort))
-    {
-      char line[256];
-      sprintf(line, "GET /service?method=channel.icon&channel_id=%d HTTP/1.0\r\n", channelID);
-      m_tcpclient->send(line, strlen(line));
-
-      sprintf(line, "Connection: close\r\n");
-      m_tcpclient->send(line, strlen(line));
-
-      sprintf(line, "\r\n");
-      m_tcpclient->send(line, strlen(line));
-
-      char buf[1024];
-      int read = m_tcpclient->receive(buf, sizeof buf, 0);
-      if (read > 0)
-      {
-        void* fileHandle = XBMC->OpenFileForWrite(iconFilename, true);
-        if (fileHandle != NULL)
-        {
-          int written = 0;
-          // HTTP response header
-          for (int i=0; i<read; i++)
-          {
-            if (buf[i] == '\r' && buf[i+1] == '\n' && buf[i+2] == '\r' && buf[i+3] == '\n')
-            {
-              XBMC->WriteFile(fileHandle, (unsigned char *)&buf[i+4], (read - (i + 4)));
-            }
-          }
-
-          // rest of body
-          bool connected = true;
-          while (connected)
-          {
-            char buf[1024];
-            int read = m_tcpclient->receive(buf, sizeof buf, 0);
-
-            if (read == 0)
-            {
-              connected = false;
-            }
-            else if (read > 0)
-            {
-              XBMC->WriteFile(fileHandle, (unsigned char *)buf, read);
-            }
-            else if (read < 0 && written > 0)
-            {
-              connected = false;
-            }
-          }
-
-          // close file
-          XBMC->CloseFile(fileHandle);
-        }
-      }
-    }
-    m_tcpclient->close();
-    return iconFilename;
-  }
-
-
-  return "";
-}
-
 PVR_ERROR cPVRClientNextPVR::GetChannels(ADDON_HANDLE handle, bool bRadio)
 {
   PVR_CHANNEL     tag;
@@ -537,8 +461,11 @@ PVR_ERROR cPVRClientNextPVR::GetChannels(ADDON_HANDLE handle, bool bRadio)
   if (DoRequest("/service?method=channel.list", response) == HTTP_OK)
   {
     TiXmlDocument doc;
+    int64_t parseStart = PLATFORM::GetTimeMs();
     if (doc.Parse(response) != NULL)
     {
+      XBMC->Log(LOG_DEBUG, "GetChannels: parsed %lu bytes in %lld ms", (unsigned long)response.length(), (long long)(PLATFORM::GetTimeMs() - parseStart));
+
       TiXmlElement* channelsNode = doc.RootElement()->FirstChildElement("channels");
       TiXmlElement* pChannelNode;
       for( pChannelNode = channelsNode->FirstChildElement("channel"); pChannelNode; pChannelNode=pChannelNode->NextSiblingElement())
@@ -549,14 +476,10 @@ PVR_ERROR cPVRClientNextPVR::GetChannels(ADDON_HANDLE handle, bool bRadio)
 
         PVR_STRCPY(tag.strChannelName, pChannelNode->FirstChildElement("name")->FirstChild()->Value());
 
-        // check if we need to download a channel icon
+        // the icon is downloaded in the background, the path is valid once it's there
         if (pChannelNode->FirstChildElement("icon"))
         {
-          CStdString iconFile = GetChannelIcon(tag.iUniqueId);
-          if (iconFile.length() > 0)
-          {
-            PVR_STRCPY(tag.strIconPath, iconFile);
-          }
+          PVR_STRCPY(tag.strIconPath, m_pIconCache->GetIconPath(tag.iUniqueId).c_str());
         }
 
         PVR_STRCPY(tag.strInputFormat, "video/x-mpegts");
@@ -681,25 +604,12 @@ PVR_ERROR cPVRClientNextPVR::GetChannelGroupMembers(ADDON_HANDLE handle, const P
 
 int cPVRClientNextPVR::GetNumRecordings(void)
 {
-  // need something more optimal, but this will do for now...
   int recordingCount = 0;
 
   CStdString response;
   if (DoRequest("/service?method=recording.list&filter=ready", response) == HTTP_OK)
   {
-    TiXmlDocument doc;
-    if (doc.Parse(response) != NULL)
-    {
-      TiXmlElement* recordingsNode = doc.RootElement()->FirstChildElement("recordings");
-      if (recordingsNode != NULL)
-      {
-        TiXmlElement* pRecordingNode;
-        for( pRecordingNode = recordingsNode->FirstChildElement("recording"); pRecordingNode; pRecordingNode=pRecordingNode->NextSiblingElement())
-        {
-          recordingCount++;
-        }
-      }
-    }
+    recordingCount = CountElements(response, "recording");
   }
   
   return recordingCount;
@@ -712,8 +622,11 @@ PVR_ERROR cPVRClientNextPVR::GetRecordings(ADDON_HANDLE handle)
   if (DoRequest("/service?method=recording.list&filter=ready", response) == HTTP_OK)
   {
     TiXmlDocument doc;
+    int64_t parseStart = PLATFORM::GetTimeMs();
     if (doc.Parse(response) != NULL)
     {
+      XBMC->Log(LOG_DEBUG, "GetRecordings: parsed %lu bytes in %lld ms", (unsigned long)response.length(), (long long)(PLATFORM::GetTimeMs() - parseStart));
+
       PVR_RECORDING   tag;
 
       TiXmlElement* recordingsNode = doc.RootElement()->FirstChildElement("recordings");
@@ -1686,28 +1599,123 @@ const char* cPVRClientNextPVR::GetLiveStreamURL(const PVR_CHANNEL &channelinfo)
 
 /************************************************************/
 /** http handling */
+/* The list methods are cached for the count/list call pairs XBMC makes for
+ * one refresh, any method that changes something drops the cache */
+static CStdString RequestMethod(const char *resource)
+{
+  const char *method = strstr(resource, "method=");
+  if (method == NULL)
+    return "";
+  method += strlen("method=");
+  return CStdString(method, strcspn(method, "&"));
+}
+
+static bool IsListMethod(const CStdString &method)
+{
+  return method == "channel.list" || method == "channel.groups" ||
+         method == "recording.list" || method == "recording.recurring.list";
+}
+
+static bool IsChangeMethod(const CStdString &method)
+{
+  return method.Right(5) == ".save" || method.Right(7) == ".delete" ||
+         method.Right(4) == ".set" || method.Left(8) == "session.";
+}
+
 int cPVRClientNextPVR::DoRequest(const char *resource, CStdString &response)
 {
-  PLATFORM::CLockObject lock(m_mutex);
+  CStdString method = RequestMethod(resource);
+  bool bCache = IsListMethod(method);
+  bool bChange = !bCache && IsChangeMethod(method);
+  unsigned iGeneration;
 
   // build request string, adding SID if requred
   CStdString strURL;
-  if (strstr(resource, "method=session") == NULL)
-    strURL.Format("http://%s:%d%s&sid=%s", g_szHostname, g_iPort, resource, m_sid);
-  else
-    strURL.Format("http://%s:%d%s", g_szHostname, g_iPort, resource);
+  {
+    PLATFORM::CLockObject lock(m_mutex);
+
+    if (bCache)
+    {
+      std::map<std::string, cCachedResponse>::const_iterator it = m_responseCache.find(resource);
+      if (it != m_responseCache.end() && PLATFORM::GetTimeMs() - it->second.time < RESPONSE_CACHE_TTL)
+      {
+        response.append(it->second.response);
+        m_iCachedRequests++;
+        return HTTP_OK;
+      }
+    }
+    else if (bChange)
+    {
+      InvalidateResponseCache();
+    }
+    iGeneration = m_iCacheGeneration;
+
+    if (strstr(resource, "method=session") == NULL)
+      strURL.Format("http://%s:%d%s&sid=%s", g_szHostname, g_iPort, resource, m_sid);
+    else
+      strURL.Format("http://%s:%d%s", g_szHostname, g_iPort, resource);
+  }
 
-  // ask XBMC to read the URL for us
+  // ask XBMC to read the URL for us, its HTTP connections are kept alive
   int resultCode = HTTP_NOTFOUND;
+  int64_t requestStart = PLATFORM::GetTimeMs();
+  CStdString body;
   void* fileHandle = XBMC->OpenFile(strURL.c_str(), 0);
   if (fileHandle)
   {
-    char buffer[1024];
-    while (XBMC->ReadFileString(fileHandle, buffer, 1024))
-      response.append(buffer);
+    char buffer[HTTP_READ_BLOCK_SIZE];
+    unsigned int read;
+    while ((read = XBMC->ReadFile(fileHandle, buffer, sizeof(buffer))) > 0)
+      body.append(buffer, read);
     XBMC->CloseFile(fileHandle);
     resultCode = HTTP_OK;
   }
-  
+  int64_t requestTime = PLATFORM::GetTimeMs() - requestStart;
+
+  XBMC->Log(LOG_DEBUG, "DoRequest: %s, %lu bytes in %lld ms", method.c_str(), (unsigned long)body.length(), (long long)requestTime);
+
+  {
+    PLATFORM::CLockObject lock(m_mutex);
+    m_iRequests++;
+    m_iRequestTime += requestTime;
+
+    // lists fetched while the change was on its way may predate it
+    if (bChange)
+      InvalidateResponseCache();
+
+    // don't keep a list that was requested before the cache was dropped
+    if (bCache && resultCode == HTTP_OK && iGeneration == m_iCacheGeneration)
+    {
+      cCachedResponse &cached = m_responseCache[resource];
+      cached.response = body;
+      cached.time = PLATFORM::GetTimeMs();
+    }
+  }
+
+  response.append(body);
   return resultCode;
 }
+
+/* Drops the cached lists. Requests still in flight won't store theirs */
+void cPVRClientNextPVR::InvalidateResponseCache()
+{
+  m_responseCache.clear();
+  m_iCacheGeneration++;
+}
+
+/* Counts the <element> elements of a response, without parsing it */
+int cPVRClientNextPVR::CountElements(const CStdString &response, const char *element)
+{
+  CStdString tag;
+  tag.Format("<%s", element);
+
+  int count = 0;
+  for (size_t pos = response.find(tag); pos != std::string::npos; pos = response.find(tag, pos + tag.length()))
+  {
+    // <channel>, <channel id="..."> but not <channelId>
+    char next = (pos + tag.length() < response.length()) ? response[pos + tag.length()] : '\0';
+    if (next == '>' || next == '/' || next == ' ' || next == '\t' || next == '\r' || next == '\n')
+      count++;
+  }
+  return count;
+}
@@ -19,6 +19,7 @@
  */
 
 #include <vector>
+#include <map>
 
 /* Master defines for client control */
 #include "xbmc_pvr_types.h"
@@ -28,6 +29,7 @@
 #include "platform/threads/mutex.h"
 #include "RingBuffer.h"
 #include "liveshift.h"
+#include "IconCache.h"
 
 #define SAFE_DELETE(p)       do { delete (p);     (p)=NULL; } while (0)
 
@@ -109,8 +111,9 @@ private:
   bool GetChannel(unsigned int number, PVR_CHANNEL &channeldata);
   bool LoadGenreXML(const std::string &filename);
   int DoRequest(const char *resource, CStdString &response);
+  void InvalidateResponseCache();
+  static int CountElements(const CStdString &response, const char *element);
   bool OpenRecordingInternal(long long seekOffset);
-  CStdString GetChannelIcon(int channelID);
   void Close();
 
   int                     m_iCurrentChannel;
@@ -133,9 +136,22 @@ private:
 
   CStdString              m_PlaybackURL;
   LiveShiftSource        *m_pLiveShiftSource;
+  cIconCache             *m_pIconCache;
 
   char                    m_sid[64];
 
   int                     m_iChannelCount;  
-  
+
+  /* List responses, reused by the count/list call pairs of one refresh */
+  struct cCachedResponse
+  {
+    CStdString response;
+    int64_t    time;
+  };
+  std::map<std::string, cCachedResponse> m_responseCache;
+  unsigned                m_iCacheGeneration;
+  int                     m_iRequests;
+  int                     m_iCachedRequests;
+  int64_t                 m_iRequestTime;
+
 };
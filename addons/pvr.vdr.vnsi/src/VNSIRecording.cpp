@@ -21,16 +21,31 @@
  */
 
 #include <limits.h>
+#include <algorithm>
 #include "VNSIRecording.h"
 #include "responsepacket.h"
 #include "requestpacket.h"
 #include "vnsicommand.h"
+#include "../../../lib/platform/util/timeutils.h"
 
 #define SEEK_POSSIBLE 0x10 // flag used to check if protocol allows seeks
 
+#define READAHEAD_BLOCK_SIZE   (256 * 1024)       // bytes per GETBLOCK request
+#define READAHEAD_REQUESTS     4                  // GETBLOCK requests kept in flight
+#define READAHEAD_KEEP         (2 * 1024 * 1024)  // bytes kept behind the read position for seeks
+#define LENGTH_UPDATE_INTERVAL 10000              // ms between size updates at the end of the recording
+
 using namespace ADDON;
+using namespace PLATFORM;
 
 cVNSIRecording::cVNSIRecording()
+  : m_currentPlayingRecordBytes(0)
+  , m_currentPlayingRecordFrames(0)
+  , m_currentPlayingRecordPosition(0)
+  , m_lengthUpdated(0)
+  , m_bufferStart(0)
+  , m_bufferEnd(0)
+  , m_requestPos(0)
 {
 }
 
@@ -66,6 +81,8 @@ bool cVNSIRecording::OpenRecording(const PVR_RECORDING& recinfo)
     m_currentPlayingRecordFrames    = vresp->extract_U32();
     m_currentPlayingRecordBytes     = vresp->extract_U64();
     m_currentPlayingRecordPosition  = 0;
+    m_lengthUpdated                 = GetTimeMs();
+    ResetReadAhead(0);
   }
   else
     XBMC->Log(LOG_ERROR, "%s - Can't open recording '%s'", __FUNCTION__, recinfo.strTitle);
@@ -79,10 +96,13 @@ void cVNSIRecording::Close()
   if(!IsOpen())
     return;
 
+  // the responses to the GETBLOCK requests still in flight are discarded
+  // while waiting for the one to the close request
   cRequestPacket vrp;
   vrp.init(VNSI_RECSTREAM_CLOSE);
   ReadSuccess(&vrp);
   cVNSISession::Close();
+  ResetReadAhead(0);
 }
 
 int cVNSIRecording::Read(unsigned char* buf, uint32_t buf_size)
@@ -101,33 +121,181 @@ int cVNSIRecording::Read(unsigned char* buf, uint32_t buf_size)
       return 0;
   }
 
-  cRequestPacket vrp;
-  if (!vrp.init(VNSI_RECSTREAM_GETBLOCK) ||
-      !vrp.add_U64(m_currentPlayingRecordPosition) ||
-      !vrp.add_U32(buf_size))
+  // Restart the read-ahead at the read position when it is neither buffered
+  // nor requested
+  if (m_currentPlayingRecordPosition < m_bufferStart ||
+      m_currentPlayingRecordPosition >= m_requestPos)
   {
-    return 0;
+    if (!ReceivePending())
+      return -1;
+    if (m_currentPlayingRecordPosition < m_bufferStart ||
+        m_currentPlayingRecordPosition >= m_bufferEnd)
+      ResetReadAhead(m_currentPlayingRecordPosition);
   }
 
-  cResponsePacket* vresp = ReadResult(&vrp);
-  if (!vresp)
+  while (m_currentPlayingRecordPosition >= m_bufferEnd)
+  {
+    if (m_pending.empty() && (!RequestBlocks() || m_pending.empty()))
+      return 0;
+
+    bool contiguous = (m_pending.front().pos == m_bufferEnd);
+    if (!ReceiveBlock())
+      return -1;
+
+    // a short block ended the window before the read position, the server
+    // has no more data there (yet)
+    if (contiguous && m_requestPos == m_bufferEnd && m_currentPlayingRecordPosition >= m_bufferEnd)
+      return 0;
+  }
+
+  // Copy what is buffered from the read position on
+  uint32_t length = 0;
+  for (std::deque<cBlock>::const_iterator it = m_blocks.begin(); it != m_blocks.end() && length < buf_size; ++it)
+  {
+    uint64_t pos = m_currentPlayingRecordPosition + length;
+    if (pos >= it->pos + it->len)
+      continue;
+
+    uint32_t offset = (uint32_t)(pos - it->pos);
+    uint32_t count = std::min(buf_size - length, it->len - offset);
+    memcpy(buf + length, it->data + offset, count);
+    length += count;
+  }
+  m_currentPlayingRecordPosition += length;
+
+  // Forget what is too far behind the read position
+  while (!m_blocks.empty() &&
+         m_blocks.front().pos + m_blocks.front().len + READAHEAD_KEEP < m_currentPlayingRecordPosition)
+  {
+    m_bufferStart += m_blocks.front().len;
+    free(m_blocks.front().data);
+    m_blocks.pop_front();
+  }
+
+  // Recordings in progress grow, ask for the size now and then once the
+  // read-ahead has reached the known end
+  if (m_requestPos >= m_currentPlayingRecordBytes && GetTimeMs() - m_lengthUpdated >= LENGTH_UPDATE_INTERVAL)
+    GetLength();
+
+  // and keep the next blocks coming in while the player works on this one
+  if (!RequestBlocks())
     return -1;
 
+  return length;
+}
+
+/* Sends GETBLOCK requests after the last one sent, until READAHEAD_REQUESTS
+ * are in flight or the (known) end of the recording is reached */
+bool cVNSIRecording::RequestBlocks()
+{
+  while (m_pending.size() < READAHEAD_REQUESTS && m_requestPos < m_currentPlayingRecordBytes)
+  {
+    cBlockRequest request;
+    request.pos = m_requestPos;
+    request.len = (uint32_t)std::min((uint64_t)READAHEAD_BLOCK_SIZE, m_currentPlayingRecordBytes - m_requestPos);
+
+    cRequestPacket vrp;
+    if (!vrp.init(VNSI_RECSTREAM_GETBLOCK) ||
+        !vrp.add_U64(request.pos) ||
+        !vrp.add_U32(request.len))
+    {
+      return false;
+    }
+
+    if (!TransmitMessage(&vrp))
+    {
+      SignalConnectionLost();
+      return false;
+    }
+
+    request.serial = vrp.getSerial();
+    m_pending.push_back(request);
+    m_requestPos += request.len;
+  }
+  return true;
+}
+
+/* Reads the response to the oldest GETBLOCK request in flight and adds its
+ * data to the window, if it continues it */
+bool cVNSIRecording::ReceiveBlock()
+{
+  if (m_pending.empty())
+    return true;
+
+  cBlockRequest request = m_pending.front();
+  m_pending.pop_front();
+
+  cResponsePacket *vresp;
+  while ((vresp = ReadMessage()))
+  {
+    if (vresp->getChannelID() == VNSI_CHANNEL_REQUEST_RESPONSE && vresp->getRequestID() == request.serial)
+      break;
+    delete vresp;
+  }
+
+  if (!vresp)
+  {
+    SignalConnectionLost();
+    return false;
+  }
+
   uint32_t length = vresp->getUserDataLength();
   uint8_t *data   = vresp->getUserData();
-  if (length > buf_size)
+  delete vresp;
+
+  if (length > request.len)
   {
     XBMC->Log(LOG_ERROR, "%s: PANIC - Received more bytes as requested", __FUNCTION__);
     free(data);
-    delete vresp;
-    return 0;
+    return true;
   }
 
-  memcpy(buf, data, length);
-  m_currentPlayingRecordPosition += length;
-  free(data);
-  delete vresp;
-  return length;
+  bool contiguous = (request.pos == m_bufferEnd);
+
+  if (length == 0 || !contiguous)
+  {
+    free(data);
+  }
+  else
+  {
+    cBlock block;
+    block.pos  = request.pos;
+    block.len  = length;
+    block.data = data;
+    m_blocks.push_back(block);
+    m_bufferEnd += length;
+  }
+
+  // After a short block the requests in flight no longer continue the window,
+  // the next requests start at its end
+  if (contiguous && length < request.len)
+    m_requestPos = m_bufferEnd;
+
+  return true;
+}
+
+/* Reads the responses to all GETBLOCK requests in flight, so that other
+ * requests can be sent on the connection */
+bool cVNSIRecording::ReceivePending()
+{
+  while (!m_pending.empty())
+  {
+    if (!ReceiveBlock())
+      return false;
+  }
+  return true;
+}
+
+void cVNSIRecording::ResetReadAhead(uint64_t pos)
+{
+  for (std::deque<cBlock>::iterator it = m_blocks.begin(); it != m_blocks.end(); ++it)
+    free(it->data);
+  m_blocks.clear();
+  m_pending.clear();
+
+  m_bufferStart = pos;
+  m_bufferEnd   = pos;
+  m_requestPos  = pos;
 }
 
 long long cVNSIRecording::Seek(long long pos, uint32_t whence)
@@ -161,9 +329,13 @@ long long cVNSIRecording::Seek(long long pos, uint32_t whence)
 
   if (nextPos >= m_currentPlayingRecordBytes)
   {
-    return 0;
+    // the recording may still be growing
+    GetLength();
+    if (nextPos >= m_currentPlayingRecordBytes)
+      return 0;
   }
 
+  // a position inside the read-ahead window is served from it by Read()
   m_currentPlayingRecordPosition = nextPos;
 
   return m_currentPlayingRecordPosition;
@@ -179,6 +351,13 @@ long long cVNSIRecording::Length(void)
   return m_currentPlayingRecordBytes;
 }
 
+void cVNSIRecording::OnDisconnect()
+{
+  // the data of the requests in flight is lost with the connection
+  m_pending.clear();
+  m_requestPos = m_bufferEnd;
+}
+
 void cVNSIRecording::OnReconnect()
 {
   OpenRecording(m_recinfo);
@@ -186,6 +365,11 @@ void cVNSIRecording::OnReconnect()
 
 void cVNSIRecording::GetLength()
 {
+  m_lengthUpdated = GetTimeMs();
+
+  if (!ReceivePending())
+    return;
+
   cRequestPacket vrp;
   if (!vrp.init(VNSI_RECSTREAM_GETLENGTH))
     return;
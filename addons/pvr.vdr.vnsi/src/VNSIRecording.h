@@ -23,6 +23,7 @@
 
 #include "VNSISession.h"
 #include "client.h"
+#include <deque>
 
 class cVNSIRecording : public cVNSISession
 {
@@ -41,13 +42,43 @@ public:
 
 protected:
 
+  void OnDisconnect();
   void OnReconnect();
   void GetLength();
 
 private:
 
+  struct cBlock
+  {
+    uint64_t pos;
+    uint32_t len;
+    uint8_t *data;
+  };
+
+  struct cBlockRequest
+  {
+    uint32_t serial;
+    uint64_t pos;
+    uint32_t len;
+  };
+
+  bool RequestBlocks();
+  bool ReceiveBlock();
+  bool ReceivePending();
+  void ResetReadAhead(uint64_t pos);
+
   PVR_RECORDING   m_recinfo;
   uint64_t        m_currentPlayingRecordBytes;
   uint32_t        m_currentPlayingRecordFrames;
   uint64_t        m_currentPlayingRecordPosition;
+  uint64_t        m_lengthUpdated;
+
+  /* Read-ahead window: m_blocks holds the data from m_bufferStart to
+   * m_bufferEnd, m_pending the GETBLOCK requests in flight, which continue
+   * up to m_requestPos */
+  std::deque<cBlock>        m_blocks;
+  std::deque<cBlockRequest> m_pending;
+  uint64_t                  m_bufferStart;
+  uint64_t                  m_bufferEnd;
+  uint64_t                  m_requestPos;
 };
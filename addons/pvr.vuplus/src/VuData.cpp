@@ -1,14 +1,24 @@
 #include "VuData.h"
+#include "VuEPGImporter.h"
 #include "client.h" 
 #include <iostream> 
 #include <fstream> 
 #include <string>
+#include <algorithm>
 #include "tinyxml/XMLUtils.h"
 
 
 using namespace ADDON;
 using namespace PLATFORM;
 
+#define VU_EPG_TAKE_TIMEOUT     60000   // ms to wait for a queued EPG request before fetching it directly
+#define VU_INITIAL_EPG_TIMEOUT  150     // s to wait for XBMC to collect the initial EPG of all channels
+
+static bool CompareEPGEntryChannel(const VuEPGEntry &left, const VuEPGEntry &right)
+{
+  return left.iChannelId < right.iChannelId;
+}
+
 bool CCurlFile::Get(const std::string &strURL, std::string &strResult)
 {
   void* fileHandle = XBMC->OpenFile(strURL.c_str(), 0);
@@ -195,13 +205,9 @@ Vu::Vu()
 
   m_bUpdating = false;
   m_iUpdateTimer = 0;
-  m_bInitialEPG = true;
 
-  std::string initialEPGReady = "special://userdata/addon_data/pvr.vuplus/initialEPGReady";
-  m_writeHandle = XBMC->OpenFileForWrite(initialEPGReady.c_str(), true);
-  XBMC->WriteFile(m_writeHandle, "Y", 1);
-  XBMC->CloseFile(m_writeHandle);
-  
+  m_epgImporter = new VuEPGImporter();
+  m_epgState = VU_EPG_STATE_INITIAL;
 }
 
 bool Vu::Open()
@@ -247,6 +253,14 @@ bool Vu::Open()
   }
   TimerUpdates();
 
+  // Fetch the now/next EPG of all groups in the background, XBMC asks for it channel by channel
+  for (int i = 0; i < m_iNumChannelGroups; i++)
+  {
+    CStdString url;
+    url.Format("%s%s%s",  m_strURL.c_str(), "web/epgnownext?bRef=",  URLEncodeInline(m_groups.at(i).strServiceReference.c_str()));
+    m_epgImporter->Queue(url);
+  }
+
   XBMC->Log(LOG_INFO, "%s Starting separate client update thread...", __FUNCTION__);
   CreateThread(); 
   
@@ -258,32 +272,31 @@ void  *Vu::Process()
   XBMC->Log(LOG_DEBUG, "%s - starting", __FUNCTION__);
 
   // Wait for the initial EPG update to complete 
-  bool bwait = true;
-  int cycles = 0;
-
-  while (bwait)
-  {
-    if (cycles == 30)
-      bwait = false;
-
-    cycles++;
-    std::string initialEPGReady = "special://userdata/addon_data/pvr.vuplus/initialEPGReady";
-    m_readHandle = XBMC->OpenFile(initialEPGReady.c_str(), 0);
-    byte buf[1];
-    XBMC->ReadFile(m_readHandle, buf, 1);
-    XBMC->CloseFile(m_readHandle);
-    char buf2[] = { "N" };
-    if (buf[0] == buf2[0])
-    {
-      XBMC->Log(LOG_DEBUG, "%s - Intial EPG update COMPLETE!", __FUNCTION__);
-    }
-    else
+  unsigned int iTimer = 0;
+  while (!WaitForEPGState(VU_EPG_STATE_INITIAL_COMPLETE, 1000))
+  {
+    if (IsStopped())
+      return NULL;
+
+    if (++iTimer >= VU_INITIAL_EPG_TIMEOUT)
     {
       XBMC->Log(LOG_DEBUG, "%s - Intial EPG update not completed yet.", __FUNCTION__);
-      Sleep(5 * 1000);
+      break;
     }
   }
 
+  if (iTimer < VU_INITIAL_EPG_TIMEOUT)
+    XBMC->Log(LOG_DEBUG, "%s - Intial EPG update COMPLETE!", __FUNCTION__);
+
+  // Prefetch the full EPG of all channels, so it is ready when XBMC asks for it
+  for (unsigned int iChannelPtr = 0; iChannelPtr < m_channels.size(); iChannelPtr++)
+  {
+    CStdString url;
+    url.Format("%s%s%s",  m_strURL.c_str(), "web/epgservice?sRef=",  URLEncodeInline(m_channels.at(iChannelPtr).strServiceReference.c_str()));
+    m_epgImporter->Queue(url);
+  }
+  SetEPGState(VU_EPG_STATE_FULL);
+
   // Trigger "Real" EPG updates 
   for (unsigned int iChannelPtr = 0; iChannelPtr < m_channels.size(); iChannelPtr++)
   {
@@ -329,6 +342,8 @@ bool Vu::LoadChannels()
   bool bOk = false;
 
   m_channels.clear();
+  m_channelsByServiceReference.clear();
+  m_channelsByName.clear();
   // Load Channels
   for (int i = 0;i<m_iNumChannelGroups;  i++) 
   {
@@ -398,6 +413,7 @@ bool Vu::LoadChannelGroups()
 
     VuChannelGroup newGroup;
     newGroup.strServiceReference = strTmp;
+    newGroup.bInitialEPGLoaded = false;
 
     if (!XMLUtils::GetString(pNode, "e2servicename", strTmp)) 
       continue;
@@ -536,6 +552,10 @@ bool Vu::LoadChannels(CStdString strServiceReference, CStdString strGroupName)
       newChannel.strIconPath = strTmp;
     }
 
+    // the first channel with a given service reference or name wins the lookup
+    m_channelsByServiceReference.insert(std::make_pair(newChannel.strServiceReference, m_channels.size()));
+    m_channelsByName.insert(std::make_pair(newChannel.strChannelName, m_channels.size()));
+
     m_channels.push_back(newChannel);
     XBMC->Log(LOG_INFO, "%s Loaded channel: %s, Icon: %s", __FUNCTION__, newChannel.strChannelName.c_str(), newChannel.strIconPath.c_str());
   }
@@ -632,9 +652,14 @@ Vu::~Vu()
   CLockObject lock(m_mutex);
   XBMC->Log(LOG_DEBUG, "%s Stopping update thread...", __FUNCTION__);
   StopThread();
+
+  XBMC->Log(LOG_DEBUG, "%s Stopping EPG importer...", __FUNCTION__);
+  delete m_epgImporter;
   
   XBMC->Log(LOG_DEBUG, "%s Removing internal channels list...", __FUNCTION__);
   m_channels.clear();  
+  m_channelsByServiceReference.clear();
+  m_channelsByName.clear();
   
   XBMC->Log(LOG_DEBUG, "%s Removing internal timers list...", __FUNCTION__);
   m_timers.clear();
@@ -660,87 +685,49 @@ bool Vu::GetInitialEPGForGroup(VuChannelGroup &group)
   CStdString url;
   url.Format("%s%s%s",  m_strURL.c_str(), "web/epgnownext?bRef=",  URLEncodeInline(group.strServiceReference.c_str())); 
  
-  CStdString strXML;
-  strXML = GetHttpXML(url);
-
-  int iNumEPG = 0;
-  
-  TiXmlDocument xmlDoc;
-  if (!xmlDoc.Parse(strXML.c_str()))
+  std::vector<VuEPGEntry> entries;
+  if (!m_epgImporter->Take(url, entries, VU_EPG_TAKE_TIMEOUT))
   {
-    XBMC->Log(LOG_DEBUG, "Unable to parse XML: %s at line %d", xmlDoc.ErrorDesc(), xmlDoc.ErrorRow());
-    return false;
-  }
-
-  TiXmlHandle hDoc(&xmlDoc);
-  TiXmlElement* pElem;
-  TiXmlHandle hRoot(0);
+    CStdString strXML;
+    strXML = GetHttpXML(url);
 
-  pElem = hDoc.FirstChildElement("e2eventlist").Element();
- 
-  if (!pElem)
-  {
-    XBMC->Log(LOG_DEBUG, "%s could not find <e2eventlist> element!", __FUNCTION__);
-    // Return "NO_ERROR" as the EPG could be empty for this channel
-    return false;
+    if (!VuEPGImporter::ParseEventList(strXML, entries))
+      return false;
   }
 
-  hRoot=TiXmlHandle(pElem);
-
-  TiXmlElement* pNode = hRoot.FirstChildElement("e2event").Element();
+  // try again with the next channel of the group, the bouquet may not have its now/next yet
+  if (entries.empty())
+    return false;
 
-  if (!pNode)
+  // a channel may be in several bouquets, so resolve the uids within this one
+  std::map<std::string, int> groupChannels;
+  for (unsigned int i = 0; i < m_channels.size(); i++)
   {
-    XBMC->Log(LOG_DEBUG, "Could not find <e2event> element");
-    // RETURN "NO_ERROR" as the EPG could be empty for this channel
-    return false;
+    if (m_channels[i].strGroupName == group.strGroupName)
+      groupChannels.insert(std::make_pair(m_channels[i].strServiceReference, m_channels[i].iUniqueId));
   }
-  
-  for (; pNode != NULL; pNode = pNode->NextSiblingElement("e2event"))
-  {
-    CStdString strTmp;
-
-    int iTmpStart;
-    int iTmp;
 
-    // check and set event starttime and endtimes
-    if (!XMLUtils::GetInt(pNode, "e2eventstart", iTmpStart)) 
-      continue;
-
-    if (!XMLUtils::GetInt(pNode, "e2eventduration", iTmp))
-      continue;
-
-    VuEPGEntry entry;
-    entry.startTime = iTmpStart;
-    entry.endTime = iTmpStart + iTmp;
-
-    if (!XMLUtils::GetInt(pNode, "e2eventid", entry.iEventId))  
-      continue;
-
-    
-    if(!XMLUtils::GetString(pNode, "e2eventtitle", strTmp))
-      continue;
+  int iNumEPG = 0;
 
-    entry.strTitle = strTmp;
+  for (unsigned int i = 0; i < entries.size(); i++)
+  {
+    VuEPGEntry &entry = entries.at(i);
 
-    if(!XMLUtils::GetString(pNode, "e2eventservicereference", strTmp))
+    std::map<std::string, int>::const_iterator it = groupChannels.find(entry.strServiceReference);
+    if (it == groupChannels.end())
       continue;
 
-    entry.strServiceReference = strTmp;
-    
-    entry.iChannelId = GetChannelNumber(entry.strServiceReference.c_str());
-
-    if (XMLUtils::GetString(pNode, "e2eventdescriptionextended", strTmp))
-      entry.strPlot = strTmp;
-
-    if (XMLUtils::GetString(pNode, "e2eventdescription", strTmp))
-       entry.strPlotOutline = strTmp;
+    // keep the channel uid only, the service reference is the same for many entries
+    entry.iChannelId = it->second;
+    entry.strServiceReference.clear();
 
     iNumEPG++; 
     
     group.initialEPG.push_back(entry);
   }
 
+  std::stable_sort(group.initialEPG.begin(), group.initialEPG.end(), CompareEPGEntryChannel);
+
   XBMC->Log(LOG_INFO, "%s Loaded %u EPG Entries for group '%s'", __FUNCTION__, iNumEPG, group.strGroupName.c_str());
   return true;
 }
@@ -752,50 +739,58 @@ PVR_ERROR Vu::GetInitialEPGForChannel(ADDON_HANDLE handle, const VuChannel &chan
 
   XBMC->Log(LOG_DEBUG, "%s Fetch information for group '%s'", __FUNCTION__, channel.strGroupName.c_str());
 
-  VuChannelGroup &myGroup = m_groups.at(0);
+  VuChannelGroup *myGroup = NULL;
   for (int i = 0;i<m_iNumChannelGroups;  i++) 
   {
-    myGroup = m_groups.at(i);
-    if (!myGroup.strGroupName.compare(channel.strGroupName))
-      if (myGroup.initialEPG.size() == 0)
-      {
-        GetInitialEPGForGroup(myGroup);
-        break;
-      }
+    if (!m_groups.at(i).strGroupName.compare(channel.strGroupName))
+    {
+      myGroup = &m_groups.at(i);
+      break;
+    }
   }
 
-  XBMC->Log(LOG_DEBUG, "%s initialEPG size is now '%d'", __FUNCTION__, myGroup.initialEPG.size());
+  if (!myGroup)
+    return PVR_ERROR_NO_ERROR;
+
+  if (!myGroup->bInitialEPGLoaded)
+    myGroup->bInitialEPGLoaded = GetInitialEPGForGroup(*myGroup);
+
+  XBMC->Log(LOG_DEBUG, "%s initialEPG size is now '%d'", __FUNCTION__, myGroup->initialEPG.size());
   
-  for (unsigned int i = 0;i<myGroup.initialEPG.size();  i++) 
+  VuEPGEntry probe;
+  probe.iChannelId = channel.iUniqueId;
+
+  std::pair<std::vector<VuEPGEntry>::iterator, std::vector<VuEPGEntry>::iterator> range = 
+    std::equal_range(myGroup->initialEPG.begin(), myGroup->initialEPG.end(), probe, CompareEPGEntryChannel);
+
+  for (std::vector<VuEPGEntry>::iterator it = range.first; it != range.second; ++it) 
   {
-    VuEPGEntry &entry = myGroup.initialEPG.at(i);
-    if (!channel.strServiceReference.compare(entry.strServiceReference)) 
-    {
-      EPG_TAG broadcast;
-      memset(&broadcast, 0, sizeof(EPG_TAG));
-
-      broadcast.iUniqueBroadcastId  = entry.iEventId;
-      broadcast.strTitle            = entry.strTitle.c_str();
-      broadcast.iChannelNumber      = channel.iChannelNumber;
-      broadcast.startTime           = entry.startTime;
-      broadcast.endTime             = entry.endTime;
-      broadcast.strPlotOutline      = entry.strPlotOutline.c_str();
-      broadcast.strPlot             = entry.strPlot.c_str();
-      broadcast.strIconPath         = ""; // unused
-      broadcast.iGenreType          = 0; // unused
-      broadcast.iGenreSubType       = 0; // unused
-      broadcast.strGenreDescription = "";
-      broadcast.firstAired          = 0;  // unused
-      broadcast.iParentalRating     = 0;  // unused
-      broadcast.iStarRating         = 0;  // unused
-      broadcast.bNotify             = false;
-      broadcast.iSeriesNumber       = 0;  // unused
-      broadcast.iEpisodeNumber      = 0;  // unused
-      broadcast.iEpisodePartNumber  = 0;  // unused
-      broadcast.strEpisodeName      = ""; // unused
-
-      PVR->TransferEpgEntry(handle, &broadcast);
-    }
+    VuEPGEntry &entry = *it;
+
+    EPG_TAG broadcast;
+    memset(&broadcast, 0, sizeof(EPG_TAG));
+
+    broadcast.iUniqueBroadcastId  = entry.iEventId;
+    broadcast.strTitle            = entry.strTitle.c_str();
+    broadcast.iChannelNumber      = channel.iChannelNumber;
+    broadcast.startTime           = entry.startTime;
+    broadcast.endTime             = entry.endTime;
+    broadcast.strPlotOutline      = entry.strPlotOutline.c_str();
+    broadcast.strPlot             = entry.strPlot.c_str();
+    broadcast.strIconPath         = ""; // unused
+    broadcast.iGenreType          = 0; // unused
+    broadcast.iGenreSubType       = 0; // unused
+    broadcast.strGenreDescription = "";
+    broadcast.firstAired          = 0;  // unused
+    broadcast.iParentalRating     = 0;  // unused
+    broadcast.iStarRating         = 0;  // unused
+    broadcast.bNotify             = false;
+    broadcast.iSeriesNumber       = 0;  // unused
+    broadcast.iEpisodeNumber      = 0;  // unused
+    broadcast.iEpisodePartNumber  = 0;  // unused
+    broadcast.strEpisodeName      = ""; // unused
+
+    PVR->TransferEpgEntry(handle, &broadcast);
   }
   return PVR_ERROR_NO_ERROR;
 }
@@ -825,106 +820,51 @@ PVR_ERROR Vu::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANNEL &channel,
     m_channels.at(channel.iUniqueId-1).bInitialEPG = false;
   
     // Check if all channels have completed the initial EPG import
-    m_bInitialEPG = false;
+    bool bInitialEPG = false;
     for (unsigned int iChannelPtr = 0; iChannelPtr < m_channels.size(); iChannelPtr++)
     {
       if (m_channels.at(iChannelPtr).bInitialEPG == true) 
       {
-        m_bInitialEPG = true;
+        bInitialEPG = true;
+        break;
       }
     }
 
-    if (!m_bInitialEPG)
-    {
-      std::string initialEPGReady = "special://userdata/addon_data/pvr.vuplus/initialEPGReady";
-      m_writeHandle = XBMC->OpenFileForWrite(initialEPGReady.c_str(), true);
-      XBMC->WriteFile(m_writeHandle, "N", 1);
-      XBMC->CloseFile(m_writeHandle);
-    }
+    if (!bInitialEPG)
+      SetEPGState(VU_EPG_STATE_INITIAL_COMPLETE);
     return GetInitialEPGForChannel(handle, myChannel, iStart, iEnd);
   }
 
   CStdString url;
   url.Format("%s%s%s",  m_strURL.c_str(), "web/epgservice?sRef=",  URLEncodeInline(myChannel.strServiceReference.c_str())); 
  
-  CStdString strXML;
-  strXML = GetHttpXML(url);
-
-  int iNumEPG = 0;
-
-  TiXmlDocument xmlDoc;
-  if (!xmlDoc.Parse(strXML.c_str()))
+  std::vector<VuEPGEntry> entries;
+  if (!m_epgImporter->Take(url, entries, VU_EPG_TAKE_TIMEOUT))
   {
-    XBMC->Log(LOG_DEBUG, "Unable to parse XML: %s at line %d", xmlDoc.ErrorDesc(), xmlDoc.ErrorRow());
-    return PVR_ERROR_SERVER_ERROR;
-  }
+    CStdString strXML;
+    strXML = GetHttpXML(url);
 
-  TiXmlHandle hDoc(&xmlDoc);
-  TiXmlElement* pElem;
-  TiXmlHandle hRoot(0);
+    if (strXML.empty())
+      return PVR_ERROR_SERVER_ERROR;
 
-  pElem = hDoc.FirstChildElement("e2eventlist").Element();
- 
-  if (!pElem)
-  {
-    XBMC->Log(LOG_DEBUG, "%s could not find <e2eventlist> element!", __FUNCTION__);
     // Return "NO_ERROR" as the EPG could be empty for this channel
-    return PVR_ERROR_NO_ERROR;
+    VuEPGImporter::ParseEventList(strXML, entries);
   }
 
-  hRoot=TiXmlHandle(pElem);
-
-  TiXmlElement* pNode = hRoot.FirstChildElement("e2event").Element();
+  int iNumEPG = 0;
 
-  if (!pNode)
+  for (unsigned int i = 0; i < entries.size(); i++)
   {
-    XBMC->Log(LOG_DEBUG, "Could not find <e2event> element");
-    // RETURN "NO_ERROR" as the EPG could be empty for this channel
-    return PVR_ERROR_SERVER_ERROR;
-  }
-  
-  for (; pNode != NULL; pNode = pNode->NextSiblingElement("e2event"))
-  {
-    CStdString strTmp;
-
-    int iTmpStart;
-    int iTmp;
-
-    // check and set event starttime and endtimes
-    if (!XMLUtils::GetInt(pNode, "e2eventstart", iTmpStart)) 
-      continue;
+    VuEPGEntry &entry = entries.at(i);
 
     // Skip unneccessary events
-    if (iStart > iTmpStart)
+    if (iStart > entry.startTime)
       continue;
  
-    if (!XMLUtils::GetInt(pNode, "e2eventduration", iTmp))
-      continue;
-
-    if ((iEnd > 1) && (iEnd < (iTmpStart + iTmp)))
+    if ((iEnd > 1) && (iEnd < entry.endTime))
        continue;
     
-    VuEPGEntry entry;
-    entry.startTime = iTmpStart;
-    entry.endTime = iTmpStart + iTmp;
-
-    if (!XMLUtils::GetInt(pNode, "e2eventid", entry.iEventId))  
-      continue;
-
     entry.iChannelId = channel.iUniqueId;
-    
-    if(!XMLUtils::GetString(pNode, "e2eventtitle", strTmp))
-      continue;
-
-    entry.strTitle = strTmp;
-    
-    entry.strServiceReference = myChannel.strServiceReference.c_str();
-
-    if (XMLUtils::GetString(pNode, "e2eventdescriptionextended", strTmp))
-      entry.strPlot = strTmp;
-
-    if (XMLUtils::GetString(pNode, "e2eventdescription", strTmp))
-       entry.strPlotOutline = strTmp;
 
     EPG_TAG broadcast;
     memset(&broadcast, 0, sizeof(EPG_TAG));
@@ -960,24 +900,42 @@ PVR_ERROR Vu::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANNEL &channel,
   return PVR_ERROR_NO_ERROR;
 }
 
-int Vu::GetChannelNumber(CStdString strServiceReference)  
+void Vu::SetEPGState(VU_EPG_STATE state)
 {
-  for (unsigned int i = 0;i<m_channels.size();  i++) 
-  {
-    if (!strServiceReference.compare(m_channels[i].strServiceReference))
-      return i+1;
-  }
-  return -1;
+  CLockObject lock(m_epgMutex);
+  m_epgState = state;
+  m_epgStateChanged.Broadcast();
 }
 
-CStdString Vu::GetChannelIconPath(CStdString strChannelName)  
+bool Vu::WaitForEPGState(VU_EPG_STATE state, uint32_t iTimeoutMs)
 {
-  for (unsigned int i = 0;i<m_channels.size();  i++) 
+  CLockObject lock(m_epgMutex);
+  CTimeout timeout(iTimeoutMs);
+
+  while (m_epgState < state)
   {
-    if (!strChannelName.compare(m_channels[i].strChannelName))
-      return m_channels[i].strIconPath;
+    uint32_t iMsLeft = timeout.TimeLeft();
+    if (iMsLeft == 0)
+      return false;
+    m_epgStateChanged.Wait(m_epgMutex, iMsLeft);
   }
-  return "";
+  return true;
+}
+
+int Vu::GetChannelNumber(const std::string &strServiceReference)  
+{
+  std::map<std::string, unsigned int>::const_iterator it = m_channelsByServiceReference.find(strServiceReference);
+  if (it == m_channelsByServiceReference.end())
+    return -1;
+  return it->second+1;
+}
+
+CStdString Vu::GetChannelIconPath(const std::string &strChannelName)  
+{
+  std::map<std::string, unsigned int>::const_iterator it = m_channelsByName.find(strChannelName);
+  if (it == m_channelsByName.end())
+    return "";
+  return m_channels[it->second].strIconPath;
 }
 
 PVR_ERROR Vu::GetTimers(ADDON_HANDLE handle)
@@ -1083,7 +1041,7 @@ std::vector<VuTimer> Vu::LoadTimers()
     timer.strTitle          = strTmp;
 
     if (XMLUtils::GetString(pNode, "e2servicereference", strTmp))
-      timer.iChannelId = GetChannelNumber(strTmp.c_str());
+      timer.iChannelId = GetChannelNumber(strTmp);
 
     if (!XMLUtils::GetInt(pNode, "e2timebegin", iTmp)) 
       continue; 
@@ -1400,7 +1358,7 @@ bool Vu::GetRecordingFromLocation(CStdString strRecordingFolder)
     if (XMLUtils::GetString(pNode, "e2servicename", strTmp))
       recording.strChannelName = strTmp;
 
-    recording.strIconPath = GetChannelIconPath(strTmp.c_str());
+    recording.strIconPath = GetChannelIconPath(strTmp);
 
     if (XMLUtils::GetInt(pNode, "e2time", iTmp)) 
       recording.startTime = iTmp;
@@ -4,6 +4,7 @@
 #include "client.h"
 #include "platform/threads/threads.h"
 #include "tinyxml/tinyxml.h"
+#include <map>
     
 #define CHANNELDATAVERSION  2
 
@@ -25,6 +26,13 @@ typedef enum VU_UPDATE_STATE
     VU_UPDATE_STATE_NEW
 } VU_UPDATE_STATE;
 
+typedef enum VU_EPG_STATE
+{
+    VU_EPG_STATE_INITIAL,
+    VU_EPG_STATE_INITIAL_COMPLETE,
+    VU_EPG_STATE_FULL
+} VU_EPG_STATE;
+
 struct VuEPGEntry 
 {
   int iEventId;
@@ -42,6 +50,7 @@ struct VuChannelGroup
   std::string strServiceReference;
   std::string strGroupName;
   int iGroupState;
+  bool bInitialEPGLoaded;
   std::vector<VuEPGEntry> initialEPG;
 };
 
@@ -122,13 +131,13 @@ struct VuRecording
   std::string strIconPath;
 };
  
+class VuEPGImporter;
+
 class Vu  : public PLATFORM::CThread
 {
 private:
 
   // members
-  void *m_writeHandle;
-  void *m_readHandle;
   std::string m_strEnigmaVersion;
   std::string m_strImageVersion;
   std::string m_strWebIfVersion;
@@ -140,6 +149,8 @@ private:
   int m_iCurrentChannel;
   unsigned int m_iUpdateTimer;
   std::vector<VuChannel> m_channels;
+  std::map<std::string, unsigned int> m_channelsByServiceReference;
+  std::map<std::string, unsigned int> m_channelsByName;
   std::vector<VuTimer> m_timers;
   std::vector<VuRecording> m_recordings;
   std::vector<VuChannelGroup> m_groups;
@@ -149,12 +160,17 @@ private:
   PLATFORM::CMutex m_mutex;
   PLATFORM::CCondition<bool> m_started;
 
+  VuEPGImporter *m_epgImporter;
+  VU_EPG_STATE m_epgState;
+  PLATFORM::CMutex m_epgMutex;
+  PLATFORM::CCondition<bool> m_epgStateChanged;
+
   bool m_bUpdating;
 
   // functions
   CStdString GetHttpXML(CStdString& url);
-  int GetChannelNumber(CStdString strServiceReference);
-  CStdString GetChannelIconPath(CStdString strChannelName);
+  int GetChannelNumber(const std::string &strServiceReference);
+  CStdString GetChannelIconPath(const std::string &strChannelName);
   bool SendSimpleCommand(const CStdString& strCommandURL, CStdString& strResult, bool bIgnoreResult = false);
   CStdString GetGroupServiceReference(CStdString strGroupName);
   bool LoadChannels(CStdString strServerReference, CStdString strGroupName);
@@ -165,6 +181,8 @@ private:
   void TimerUpdates();
   bool GetDeviceInfo();
   int GetRecordingIndex(CStdString);
+  void SetEPGState(VU_EPG_STATE state);
+  bool WaitForEPGState(VU_EPG_STATE state, uint32_t iTimeoutMs);
 
   // helper functions
   static long TimeStringToSeconds(const CStdString &timeString);
@@ -214,6 +232,5 @@ public:
   long long SeekLiveStream(long long iPosition, int iWhence /* = SEEK_SET */);
   long long PositionLiveStream(void);
   long long LengthLiveStream(void);
-  bool m_bInitialEPG;
 };
 
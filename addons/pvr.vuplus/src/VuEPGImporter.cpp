@@ -0,0 +1,382 @@
+#include "VuEPGImporter.h"
+#include "client.h"
+#include "platform/util/timeutils.h"
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ADDON;
+using namespace PLATFORM;
+
+void *VuEPGWorker::Process(void)
+{
+  std::string strURL;
+
+  while (!IsStopped() && m_importer.NextJob(strURL))
+  {
+    int64_t iStartTime = GetTimeMs();
+
+    CCurlFile http;
+    std::string strXML;
+    std::vector<VuEPGEntry> entries;
+
+    // a reply without an <e2eventlist> has no events, it isn't an error
+    bool bSuccess = http.Get(strURL, strXML);
+    if (bSuccess)
+      VuEPGImporter::ParseEventList(strXML, entries);
+
+    XBMC->Log(LOG_DEBUG, "%s Loaded %u EPG entries (%u bytes) in %d ms from '%s'", __FUNCTION__,
+        entries.size(), strXML.length(), (int)(GetTimeMs() - iStartTime), strURL.c_str());
+
+    m_importer.JobDone(strURL, bSuccess, entries);
+  }
+
+  return NULL;
+}
+
+VuEPGImporter::VuEPGImporter(unsigned int iWorkers) :
+  m_bCancelled(false)
+{
+  for (unsigned int i = 0; i < iWorkers; i++)
+    m_workers.push_back(new VuEPGWorker(*this));
+}
+
+VuEPGImporter::~VuEPGImporter(void)
+{
+  Cancel();
+
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+    delete m_workers[i];
+  m_workers.clear();
+}
+
+void VuEPGImporter::Queue(const std::string &strURL)
+{
+  CLockObject lock(m_mutex);
+
+  if (m_bCancelled)
+    return;
+
+  ExpireJobs();
+
+  std::map<std::string, VuEPGJob>::iterator it = m_jobs.find(strURL);
+  if (it != m_jobs.end() && it->second.state != VU_EPG_JOB_FAILED)
+    return;
+
+  VuEPGJob &job = m_jobs[strURL];
+  job.state = VU_EPG_JOB_QUEUED;
+  job.iDoneTime = 0;
+  job.entries.clear();
+  m_queue.push_back(strURL);
+
+  // the workers are started with the first request and stay idle in between
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+  {
+    if (!m_workers[i]->IsRunning())
+      m_workers[i]->CreateThread(false);
+  }
+
+  m_jobQueued.Signal();
+}
+
+bool VuEPGImporter::Take(const std::string &strURL, std::vector<VuEPGEntry> &entries, uint32_t iTimeoutMs)
+{
+  CLockObject lock(m_mutex);
+
+  // the URLs don't change over time, so an old result counts as a miss
+  ExpireJobs();
+
+  std::map<std::string, VuEPGJob>::iterator it = m_jobs.find(strURL);
+  if (it == m_jobs.end())
+    return false;
+
+  CTimeout timeout(iTimeoutMs);
+  while (it->second.state == VU_EPG_JOB_QUEUED || it->second.state == VU_EPG_JOB_RUNNING)
+  {
+    uint32_t iMsLeft = timeout.TimeLeft();
+    if (iMsLeft == 0 || m_bCancelled)
+    {
+      XBMC->Log(LOG_DEBUG, "%s Gave up waiting for '%s'", __FUNCTION__, strURL.c_str());
+      return false;
+    }
+    m_jobDone.Wait(m_mutex, iMsLeft);
+
+    // another Take() for the same request may have collected it meanwhile
+    it = m_jobs.find(strURL);
+    if (it == m_jobs.end())
+      return false;
+  }
+
+  bool bSuccess = it->second.state == VU_EPG_JOB_DONE;
+  if (bSuccess)
+    entries.swap(it->second.entries);
+  m_jobs.erase(it);
+
+  return bSuccess;
+}
+
+void VuEPGImporter::Cancel(void)
+{
+  {
+    CLockObject lock(m_mutex);
+    m_bCancelled = true;
+    m_queue.clear();
+    m_jobQueued.Broadcast();
+    m_jobDone.Broadcast();
+  }
+
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+    m_workers[i]->StopThread();
+}
+
+bool VuEPGImporter::NextJob(std::string &strURL)
+{
+  CLockObject lock(m_mutex);
+
+  while (m_queue.empty())
+  {
+    if (m_bCancelled)
+      return false;
+    m_jobQueued.Wait(m_mutex, 1000);
+  }
+
+  if (m_bCancelled)
+    return false;
+
+  strURL = m_queue.front();
+  m_queue.pop_front();
+  m_jobs[strURL].state = VU_EPG_JOB_RUNNING;
+
+  return true;
+}
+
+void VuEPGImporter::JobDone(const std::string &strURL, bool bSuccess, std::vector<VuEPGEntry> &entries)
+{
+  CLockObject lock(m_mutex);
+
+  std::map<std::string, VuEPGJob>::iterator it = m_jobs.find(strURL);
+  if (it == m_jobs.end())
+    return;
+
+  it->second.state = bSuccess ? VU_EPG_JOB_DONE : VU_EPG_JOB_FAILED;
+  it->second.iDoneTime = GetTimeMs();
+  it->second.entries.swap(entries);
+
+  m_jobDone.Broadcast();
+}
+
+/*
+ * Drops finished requests that are stale or were never collected, e.g. for
+ * channels XBMC didn't ask for or after Take() gave up waiting. Called with
+ * m_mutex held.
+ */
+void VuEPGImporter::ExpireJobs(void)
+{
+  int64_t iNow = GetTimeMs();
+
+  std::map<std::string, VuEPGJob>::iterator it = m_jobs.begin();
+  while (it != m_jobs.end())
+  {
+    if ((it->second.state == VU_EPG_JOB_DONE || it->second.state == VU_EPG_JOB_FAILED) &&
+        iNow - it->second.iDoneTime > VU_EPG_JOB_EXPIRY)
+      m_jobs.erase(it++);
+    else
+      ++it;
+  }
+}
+
+/*
+ * Walks the <e2event> records of an enigma2 <e2eventlist> in place, without
+ * building a DOM for the whole (often multi megabyte) reply.
+ */
+bool VuEPGImporter::ParseEventList(const std::string &strXML, std::vector<VuEPGEntry> &entries)
+{
+  size_t iPos = strXML.find("<e2eventlist");
+
+  if (iPos == std::string::npos)
+  {
+    XBMC->Log(LOG_DEBUG, "%s could not find <e2eventlist> element!", __FUNCTION__);
+    return false;
+  }
+
+  while ((iPos = strXML.find("<e2event>", iPos)) != std::string::npos)
+  {
+    size_t iEnd = strXML.find("</e2event>", iPos);
+    if (iEnd == std::string::npos)
+      break;
+
+    VuEPGEntry entry;
+    entry.iChannelId = -1;
+    if (ParseEvent(strXML, iPos + strlen("<e2event>"), iEnd, entry))
+      entries.push_back(entry);
+
+    iPos = iEnd + strlen("</e2event>");
+  }
+
+  return true;
+}
+
+static inline bool TagIs(const std::string &strXML, size_t iPos, size_t iLen, const char *strTag)
+{
+  return iLen == strlen(strTag) && strXML.compare(iPos, iLen, strTag) == 0;
+}
+
+bool VuEPGImporter::ParseEvent(const std::string &strXML, size_t iPos, size_t iEnd, VuEPGEntry &entry)
+{
+  bool bStart = false, bDuration = false, bId = false, bTitle = false;
+  int iStart = 0, iDuration = 0;
+  std::string strValue;
+
+  while ((iPos = strXML.find('<', iPos)) < iEnd)
+  {
+    size_t iName = iPos + 1;
+    size_t iNameEnd = strXML.find_first_of(" \t\r\n/>", iName);
+    size_t iTagEnd = strXML.find('>', iName);
+    if (iNameEnd >= iEnd || iTagEnd >= iEnd)
+      break;
+
+    size_t iNameLen = iNameEnd - iName;
+
+    strValue.clear();
+    if (strXML[iTagEnd - 1] == '/')
+    {
+      iPos = iTagEnd + 1;
+    }
+    else
+    {
+      size_t iValueEnd = strXML.find('<', iTagEnd + 1);
+      if (iValueEnd > iEnd)
+        break;
+
+      DecodeEntities(strXML, iTagEnd + 1, iValueEnd, strValue);
+      iPos = strXML.find('>', iValueEnd);
+      if (iPos == std::string::npos)
+        break;
+      iPos++;
+    }
+
+    // empty elements count as missing, as they do for XMLUtils
+    if (strValue.empty())
+      continue;
+
+    if (TagIs(strXML, iName, iNameLen, "e2eventid"))
+    {
+      entry.iEventId = atoi(strValue.c_str());
+      bId = true;
+    }
+    else if (TagIs(strXML, iName, iNameLen, "e2eventstart"))
+    {
+      iStart = atoi(strValue.c_str());
+      bStart = true;
+    }
+    else if (TagIs(strXML, iName, iNameLen, "e2eventduration"))
+    {
+      iDuration = atoi(strValue.c_str());
+      bDuration = true;
+    }
+    else if (TagIs(strXML, iName, iNameLen, "e2eventtitle"))
+    {
+      entry.strTitle = strValue;
+      bTitle = true;
+    }
+    else if (TagIs(strXML, iName, iNameLen, "e2eventdescription"))
+      entry.strPlotOutline = strValue;
+    else if (TagIs(strXML, iName, iNameLen, "e2eventdescriptionextended"))
+      entry.strPlot = strValue;
+    else if (TagIs(strXML, iName, iNameLen, "e2eventservicereference"))
+      entry.strServiceReference = strValue;
+  }
+
+  if (!bStart || !bDuration || !bId || !bTitle)
+    return false;
+
+  entry.startTime = iStart;
+  entry.endTime = iStart + iDuration;
+
+  return true;
+}
+
+static void AppendUTF8(std::string &strValue, unsigned long iCode)
+{
+  if (iCode < 0x80)
+    strValue += (char)iCode;
+  else if (iCode < 0x800)
+  {
+    strValue += (char)(0xC0 | (iCode >> 6));
+    strValue += (char)(0x80 | (iCode & 0x3F));
+  }
+  else if (iCode < 0x10000)
+  {
+    strValue += (char)(0xE0 | (iCode >> 12));
+    strValue += (char)(0x80 | ((iCode >> 6) & 0x3F));
+    strValue += (char)(0x80 | (iCode & 0x3F));
+  }
+  else
+  {
+    strValue += (char)(0xF0 | (iCode >> 18));
+    strValue += (char)(0x80 | ((iCode >> 12) & 0x3F));
+    strValue += (char)(0x80 | ((iCode >> 6) & 0x3F));
+    strValue += (char)(0x80 | (iCode & 0x3F));
+  }
+}
+
+/*
+ * Copies element text, resolving entities and condensing white space the
+ * same way TinyXML does.
+ */
+void VuEPGImporter::DecodeEntities(const std::string &strXML, size_t iPos, size_t iEnd, std::string &strValue)
+{
+  bool bSpace = false;
+
+  for (; iPos < iEnd; iPos++)
+  {
+    char c = strXML[iPos];
+
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+      bSpace = true;
+      continue;
+    }
+
+    if (bSpace && !strValue.empty())
+      strValue += ' ';
+    bSpace = false;
+
+    if (c != '&')
+    {
+      strValue += c;
+      continue;
+    }
+
+    size_t iSemi = strXML.find(';', iPos);
+    if (iSemi >= iEnd || iSemi - iPos > 10)
+    {
+      strValue += c;
+      continue;
+    }
+
+    size_t iLen = iSemi - iPos - 1;
+    if (TagIs(strXML, iPos + 1, iLen, "amp"))
+      strValue += '&';
+    else if (TagIs(strXML, iPos + 1, iLen, "lt"))
+      strValue += '<';
+    else if (TagIs(strXML, iPos + 1, iLen, "gt"))
+      strValue += '>';
+    else if (TagIs(strXML, iPos + 1, iLen, "quot"))
+      strValue += '"';
+    else if (TagIs(strXML, iPos + 1, iLen, "apos"))
+      strValue += '\'';
+    else if (iLen > 1 && strXML[iPos + 1] == '#')
+    {
+      const char *strCode = strXML.c_str() + iPos + 2;
+      unsigned long iCode = (*strCode == 'x' || *strCode == 'X') ? strtoul(strCode + 1, NULL, 16) : strtoul(strCode, NULL, 10);
+      AppendUTF8(strValue, iCode);
+    }
+    else
+    {
+      strValue += c;
+      continue;
+    }
+
+    iPos = iSemi;
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "VuData.h"
+#include <map>
+#include <deque>
+
+#define VU_EPG_WORKERS    4
+#define VU_EPG_JOB_EXPIRY 300000  // ms a finished request is kept and served, older results are stale
+
+class VuEPGImporter;
+
+class VuEPGWorker : public PLATFORM::CThread
+{
+public:
+  VuEPGWorker(VuEPGImporter &importer) : m_importer(importer) {};
+  ~VuEPGWorker(void) {};
+
+protected:
+  virtual void *Process(void);
+
+private:
+  VuEPGImporter &m_importer;
+};
+
+/*
+ * Fetches enigma2 event lists (web/epgnownext, web/epgservice) on a bounded
+ * pool of worker threads. Each request is identified by its URL; the parsed
+ * events are kept until they are collected with Take().
+ */
+class VuEPGImporter
+{
+  friend class VuEPGWorker;
+
+public:
+  VuEPGImporter(unsigned int iWorkers = VU_EPG_WORKERS);
+  ~VuEPGImporter(void);
+
+  void Queue(const std::string &strURL);
+  bool Take(const std::string &strURL, std::vector<VuEPGEntry> &entries, uint32_t iTimeoutMs);
+  void Cancel(void);
+
+  static bool ParseEventList(const std::string &strXML, std::vector<VuEPGEntry> &entries);
+
+private:
+  typedef enum VU_EPG_JOB_STATE
+  {
+    VU_EPG_JOB_QUEUED,
+    VU_EPG_JOB_RUNNING,
+    VU_EPG_JOB_DONE,
+    VU_EPG_JOB_FAILED
+  } VU_EPG_JOB_STATE;
+
+  struct VuEPGJob
+  {
+    VU_EPG_JOB_STATE state;
+    int64_t iDoneTime;
+    std::vector<VuEPGEntry> entries;
+  };
+
+  bool NextJob(std::string &strURL);
+  void JobDone(const std::string &strURL, bool bSuccess, std::vector<VuEPGEntry> &entries);
+  void ExpireJobs(void);
+
+  static bool ParseEvent(const std::string &strXML, size_t iPos, size_t iEnd, VuEPGEntry &entry);
+  static void DecodeEntities(const std::string &strXML, size_t iPos, size_t iEnd, std::string &strValue);
+
+  std::vector<VuEPGWorker*> m_workers;
+  std::deque<std::string> m_queue;
+  std::map<std::string, VuEPGJob> m_jobs;
+  bool m_bCancelled;
+
+  PLATFORM::CMutex m_mutex;
+  PLATFORM::CCondition<bool> m_jobQueued;
+  PLATFORM::CCondition<bool> m_jobDone;
+};
@@ -0,0 +1,230 @@
+/*
+*      Copyright (C) 2011 Pulse-Eight
+*      http://www.pulse-eight.com/
+*
+*  This Program is free software; you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 2, or (at your option)
+*  any later version.
+*
+*  This Program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with XBMC; see the file COPYING.  If not, write to
+*  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+*  MA 02110-1301  USA
+*  http://www.gnu.org/copyleft/gpl.html
+*
+*/
+
+#include "StreamSizeTracker.h"
+#include "client.h"
+#include "platform/util/timeutils.h"
+
+using namespace ADDON;
+using namespace PLATFORM;
+
+#define IDLE_POLL_MS	2000		// poll interval while no reader is waiting (keeps the write rate current)
+#define MIN_POLL_MS		100			// never query the server more often than this while a reader waits
+#define MAX_POLL_MS		600			// never wait longer than this between queries while a reader waits
+#define WAIT_SLICE_MS	100			// longest a reader sleeps on the condition before rechecking its timeout
+#define RATE_WEIGHT		0.25		// weight of a new sample in the smoothed write rate
+
+StreamSizeTracker::StreamSizeTracker(Socket &socketClient) :
+	_socketClient(socketClient),
+	_isTracking(false),
+	_updated(false),
+	_size(0),
+	_isGrowing(false),
+	_serverError(false),
+	_required(0),
+	_pollCnt(0),
+	_lastSampleTime(0),
+	_lastSampleSize(0),
+	_bytesPerMs(0),
+	_stallCnt(0),
+	_stallTotalMs(0),
+	_stallMaxMs(0),
+	_queryCnt(0)
+{
+}
+
+StreamSizeTracker::~StreamSizeTracker(void)
+{
+	Stop();
+}
+
+void StreamSizeTracker::Start(void)
+{
+	Stop();											// stop tracking any previous stream file
+
+	{
+		CLockObject lock(_mutex);
+		_isTracking = true;
+		_updated = false;
+		_size = 0;
+		_isGrowing = true;							// initially assume the file is growing
+		_serverError = false;
+		_required = 0;
+		_pollCnt = 0;
+		_lastSampleTime = 0;
+		_lastSampleSize = 0;
+		_bytesPerMs = 0;
+		_stallCnt = 0;
+		_stallTotalMs = 0;
+		_stallMaxMs = 0;
+		_queryCnt = 0;
+	}
+
+	CreateThread(false);
+}
+
+void StreamSizeTracker::Stop(void)
+{
+	StopThread(-1);									// flag the thread to stop
+	_pollNow.Signal();								// wake it if it is waiting for its next poll
+	StopThread();
+
+	CLockObject lock(_mutex);
+	if (!_isTracking)
+		return;
+	_isTracking = false;
+	XBMC->Log(LOG_DEBUG, "StreamSizeTracker> stopped: size %lld, rate %.0f kB/s, %d queries, %d stalls, stall time total %lld ms, max %lld ms",
+		_size, _bytesPerMs * 1000 / 1024, _queryCnt, _stallCnt, _stallTotalMs, _stallMaxMs);
+}
+
+long long StreamSizeTracker::Size(void)
+{
+	CLockObject lock(_mutex);
+	return _size;
+}
+
+bool StreamSizeTracker::IsGrowing(void)
+{
+	CLockObject lock(_mutex);
+	return _isGrowing;
+}
+
+StreamSizeTracker::WaitResult StreamSizeTracker::WaitForSize(long long required, uint32_t iTimeoutMs, long long &fileSize)
+{
+	CLockObject lock(_mutex);
+
+	if (_size < required && _isGrowing && !_serverError)
+	{
+		int64_t waitStart = GetTimeMs();
+		CTimeout timeout(iTimeoutMs);
+
+		_required = required;						// tell the tracker what we are waiting for
+		_pollCnt = 0;
+		_pollNow.Signal();							// and get a fresh size right away
+
+		while (_size < required && _isGrowing && !_serverError)
+		{
+			uint32_t iMsLeft = timeout.TimeLeft();
+			if (iMsLeft == 0)
+				break;
+			_updated = false;
+			_sizeChanged.Wait(_mutex, _updated, iMsLeft < WAIT_SLICE_MS ? iMsLeft : WAIT_SLICE_MS);
+		}
+		_required = 0;
+
+		int64_t waitMs = GetTimeMs() - waitStart;	// record the stall
+		_stallCnt++;
+		_stallTotalMs += waitMs;
+		if (waitMs > _stallMaxMs)
+			_stallMaxMs = waitMs;
+	}
+
+	fileSize = _size;
+
+	if (_serverError)
+		return SERVER_ERROR;
+	if (_size >= required)
+		return SIZE_AVAILABLE;
+	return _isGrowing ? TIMED_OUT : NOT_GROWING;
+}
+
+void *StreamSizeTracker::Process(void)
+{
+	while (!IsStopped())
+	{
+		_pollNow.Wait(NextPollDelay());				// sleep until the next poll is due or a reader needs a size
+		if (IsStopped())
+			break;
+
+		QuerySize();
+
+		CLockObject lock(_mutex);
+		if (!_isGrowing || _serverError)			// nothing more to track
+			break;
+	}
+	return NULL;
+}
+
+uint32_t StreamSizeTracker::NextPollDelay(void)
+{
+	CLockObject lock(_mutex);
+
+	if (_required == 0)
+		return IDLE_POLL_MS;
+	if (_bytesPerMs <= 0 || _lastSampleTime == 0)	// no write rate learned yet
+		return MIN_POLL_MS;
+
+	// predict when the file reaches the size the reader is waiting for, based on the learned write rate
+	double predictedSize = _lastSampleSize + _bytesPerMs * (GetTimeMs() - _lastSampleTime);
+	double delay = (_required - predictedSize) / _bytesPerMs;
+
+	if (delay < MIN_POLL_MS)
+		return MIN_POLL_MS;
+	if (delay > MAX_POLL_MS)
+		return MAX_POLL_MS;
+	return (uint32_t)delay;
+}
+
+void StreamSizeTracker::QuerySize(void)
+{
+	int count;
+	{
+		CLockObject lock(_mutex);
+		count = _required > 0 ? _pollCnt++ : 0;		// number of consecutive queries for a waiting reader
+	}
+
+	CStdString request;
+	request.Format("StreamFileSize|%d", count);		// request stream size form client, passing number of consecutive queries
+	long long lFileSize = _socketClient.GetLL(request, true);
+	int64_t now = GetTimeMs();
+
+	CLockObject lock(_mutex);
+	_queryCnt++;
+
+	if (lFileSize == -1)							// server is reporting an 'unkown' error with the stream
+	{
+		_serverError = true;
+	}
+	else
+	{
+		if (lFileSize < -1)							// a negative file size means the stream file is no longer growing
+		{
+			lFileSize = -lFileSize;
+			_isGrowing = false;
+		}
+
+		if (lFileSize > _size)						// update the write rate with this sample
+		{
+			if (_lastSampleTime > 0 && now > _lastSampleTime)
+			{
+				double sample = (double)(lFileSize - _lastSampleSize) / (now - _lastSampleTime);
+				_bytesPerMs = _bytesPerMs > 0 ? _bytesPerMs + RATE_WEIGHT * (sample - _bytesPerMs) : sample;
+			}
+			_lastSampleTime = now;
+			_lastSampleSize = lFileSize;
+		}
+		_size = lFileSize;
+	}
+
+	_updated = true;
+	_sizeChanged.Broadcast();						// wake any waiting reader
+}
@@ -0,0 +1,84 @@
+#pragma once
+/*
+*      Copyright (C) 2011 Pulse-Eight
+*      http://www.pulse-eight.com/
+*
+*  This Program is free software; you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 2, or (at your option)
+*  any later version.
+*
+*  This Program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with XBMC; see the file COPYING.  If not, write to
+*  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+*  MA 02110-1301  USA
+*  http://www.gnu.org/copyleft/gpl.html
+*
+*/
+
+#include "platform/threads/threads.h"
+#include "platform/util/StdString.h"
+#include "Socket.h"
+
+// Tracks the size of a growing live/rec TS stream file in the background.  The tracker polls the
+// server for the stream file size, learns the rate at which the file is being written and schedules
+// its next poll for the time the data a reader is waiting for is predicted to be available.
+// Readers block on a condition (woken by each size update) instead of sleeping a fixed interval.
+class StreamSizeTracker : public PLATFORM::CThread
+{
+public:
+	enum WaitResult
+	{
+		SIZE_AVAILABLE,			// the stream file is big enough for the read
+		NOT_GROWING,			// the stream file stopped growing before it got big enough
+		SERVER_ERROR,			// the server reported an error with the stream
+		TIMED_OUT,				// the stream file didn't grow big enough in time
+	};
+
+	StreamSizeTracker(Socket &socketClient);
+	virtual ~StreamSizeTracker(void);
+
+	void Start(void);							// start tracking a newly opened stream file
+	void Stop(void);							// stop tracking and log stall statistics
+
+	// wait until the stream file holds at least 'required' bytes, 'fileSize' receives the last known size
+	WaitResult WaitForSize(long long required, uint32_t iTimeoutMs, long long &fileSize);
+
+	long long Size(void);						// last known stream file size
+	bool IsGrowing(void);						// false once the server reports the file is complete
+
+	virtual void *Process(void);
+
+private:
+	void QuerySize(void);						// ask the server for the current size and wake waiting readers
+	uint32_t NextPollDelay(void);				// ms to wait before the next size query
+
+	Socket &_socketClient;
+
+	PLATFORM::CMutex _mutex;
+	PLATFORM::CCondition<volatile bool> _sizeChanged;	// broadcast on every size update
+	PLATFORM::CEvent _pollNow;					// signalled by a reader that needs a fresh size immediately
+
+	bool _isTracking;							// true between Start and Stop
+	volatile bool _updated;						// set on each size update, cleared by waiting readers
+	long long _size;							// last stream file size reported by the server
+	bool _isGrowing;							// true while the server reports the file is still growing
+	bool _serverError;							// true if the server reported an error with the stream
+	long long _required;						// size a reader is currently waiting for (0 = none)
+	int _pollCnt;								// consecutive queries made for the current waiting reader
+
+	int64_t _lastSampleTime;					// time (ms) of the last size sample that grew the file
+	long long _lastSampleSize;					// size at _lastSampleTime
+	double _bytesPerMs;							// smoothed write rate of the stream file
+
+	// stall statistics
+	int _stallCnt;								// number of reads that had to wait for data
+	int64_t _stallTotalMs;						// total time spent waiting for data
+	int64_t _stallMaxMs;						// longest single wait
+	int _queryCnt;								// number of size queries sent to the server
+};
@@ -37,11 +37,13 @@ using namespace PLATFORM;
 #define FOREACH(ss, vv) for(std::vector<CStdString>::iterator ss = vv.begin(); ss != vv.end(); ++ss)
 
 #define FAKE_TS_LENGTH 2000000			// a fake file length for give to xbmc (used to insert duration headers)
+#define STREAM_TIMEOUT_MS 30000			// give up on a growing stream file that doesn't grow big enough for a read in 30 sec
 
 int64_t _lastRecordingUpdateTime;		// the time of the last recording display update
 
 
-Pvr2Wmc::Pvr2Wmc(void)
+Pvr2Wmc::Pvr2Wmc(void) :
+	_sizeTracker(_socketClient)
 {
 	_socketClient.SetServerName(g_strServerName);
 	_socketClient.SetClientName(g_strClientName);
@@ -927,6 +929,8 @@ bool Pvr2Wmc::OpenLiveStream(const PVR_CHANNEL &channel)
 		_lastStreamSize = 0;
 		_isStreamFileGrowing = true;
 		_insertDurationHeader = false;				// only used for active recordings
+		if (!_streamWTV)
+			_sizeTracker.Start();					// track the size of the growing ts file
 		return true;								// stream is up
 	}
 }
@@ -948,8 +952,6 @@ int Pvr2Wmc::ReadLiveStream(unsigned char *pBuffer, unsigned int iBufferSize)
 
 	if (!_streamWTV)									// if NOT streaming wtv, make sure stream is big enough before it is read
 	{						
-		int timeout = 0;								// reset timeout counter
-
 		// If we are trying to skip to an initial start position (eg we are watching an existing live stream
 		// in a multiple client scenario), we need to do it here, as the Seek command didnt work in OpenLiveStream,
 		// XBMC just started playing from the start of the file anyway.  But once the stream is open, XBMC repeatedly 
@@ -1009,38 +1011,33 @@ int Pvr2Wmc::ReadLiveStream(unsigned char *pBuffer, unsigned int iBufferSize)
 		if (_readCnt > 50)
 			_insertDurationHeader = false;
 
-		long long fileSize = _lastStreamSize;			// use the last fileSize found, rather than querying host
-
-		if (_isStreamFileGrowing && currentPos + iBufferSize > fileSize)	// if its not big enough for the readsize
-			fileSize = ActualFileSize(timeout);								// get the current size of the stream file
+		long long fileSize = _sizeTracker.Size();		// use the last fileSize found by the tracker, rather than querying host
+		_lastStreamSize = fileSize;
 
 		// if the stream file is growing, see if the stream file is big enough to accomodate this read
-		// if its not, wait until it is
-		while (_isStreamFileGrowing && currentPos + iBufferSize > fileSize)
+		// if its not, wait until the size tracker sees it grow big enough
+		if (_isStreamFileGrowing && currentPos + iBufferSize > fileSize)
 		{
-			usleep(600000);								// wait a little (600ms) before we try again
-			timeout++;
-			fileSize = ActualFileSize(timeout);			// get new file size after delay
+			StreamSizeTracker::WaitResult result = _sizeTracker.WaitForSize(currentPos + iBufferSize, STREAM_TIMEOUT_MS, fileSize);
+			_lastStreamSize = fileSize;
+			_isStreamFileGrowing = _sizeTracker.IsGrowing();
 
-			if (!_isStreamFileGrowing)					// if streamfile is no longer growing...
+			if (result == StreamSizeTracker::NOT_GROWING)	// if streamfile is no longer growing...
 			{
 				if (CheckErrorOnServer())				// see if server says there is an error
 				{
 					_lostStream = true;					// if an error was posted, close the stream down
 					return -1;																
 				}
-				else
-					break;								// terminate loop since stream file isn't growing no sense in waiting
 			}
-			else if (fileSize == -1)					// if fileSize -1, server is reporting an 'unkown' error with the stream
+			else if (result == StreamSizeTracker::SERVER_ERROR)	// server is reporting an 'unkown' error with the stream
 			{
 				XBMC->QueueNotification(QUEUE_ERROR, XBMC->GetLocalizedString(30003));	// display generic error with stream
 				XBMC->Log(LOG_DEBUG, "live tv error, server reported error");
 				_lostStream = true;														// flag that stream is down
 				return -1;																
 			}
-
-			if (timeout > 50 )									// if after 30 sec the file has not grown big enough, timeout
+			else if (result == StreamSizeTracker::TIMED_OUT)	// if after 30 sec the file has not grown big enough, timeout
 			{
 				_lostStream = true;								// flag that stream is down
 				if (currentPos == 0 && fileSize == 0)			// if no data was ever read, assume no video signal
@@ -1103,34 +1100,6 @@ long long Pvr2Wmc::PositionLiveStream(void)
 	return lFilePos;
 }
 
-// get stream file size, querying it from server if needed
-long long Pvr2Wmc::ActualFileSize(int count)
-{
-	long long lFileSize = 0;
-
-	if (_lostStream)									// if stream was lost, return 0 file size (may not be needed)
-		return 0;
-
-	if (!_isStreamFileGrowing)							// if stream file is no longer growing, return the last stream size
-	{
-		lFileSize = _lastStreamSize;
-	}
-	else
-	{
-		CStdString request;
-		request.Format("StreamFileSize|%d", count);		// request stream size form client, passing number of consecutive queries
-		lFileSize = _socketClient.GetLL(request, true);	// get file size form client
-
-		if (lFileSize < -1)								// if server returns a negative file size, it means the stream file is no longer growing (-1 => error)
-		{
-			lFileSize = -lFileSize;						// make stream file length positive
-			_isStreamFileGrowing = false;				// flag that stream file is no longer growing
-		}
-		_lastStreamSize = lFileSize;					// save this stream size
-	}
-	return lFileSize;
-}
-
 // return the length of the current stream file
 long long Pvr2Wmc::LengthLiveStream(void) 
 {
@@ -1147,6 +1116,8 @@ void Pvr2Wmc::PauseStream(bool bPaused)
 
 bool Pvr2Wmc::CloseLiveStream(bool notifyServer /*=true*/)
 {
+	_sizeTracker.Stop();						// stop tracking the stream file size
+
 	if (IsServerDown())
 		return false;
 
@@ -1232,6 +1203,8 @@ bool Pvr2Wmc::OpenRecordedStream(const PVR_RECORDING &recording)
 		_lostStream = false;						// stream is open
 		_lastStreamSize = 0;						// current size is empty
 		_isStreamFileGrowing = true;				// initially assume its growing
+		if (!_streamWTV)
+			_sizeTracker.Start();					// track the size of the growing ts file
 
 		// Initialise variables for starting stream at an offset (only used for live streams)
 		_initialStreamResetCnt = 0;
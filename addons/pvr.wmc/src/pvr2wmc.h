@@ -25,6 +25,7 @@
 #include "platform/util/StdString.h"
 #include "client.h"
 #include "Socket.h"
+#include "StreamSizeTracker.h"
 
 class Pvr2Wmc 
 {
@@ -75,7 +76,6 @@ public:
 	long long PositionLiveStream(void) ;
 	bool SwitchChannel(const PVR_CHANNEL &channel);
 	long long LengthLiveStream(void);
-	long long ActualFileSize(int count);
 	PVR_ERROR SignalStatus(PVR_SIGNAL_STATUS &signalStatus);
 	
 	bool CheckErrorOnServer();
@@ -96,6 +96,7 @@ private:
 	bool _lostStream;					// set to true if stream is lost
 	
 	bool _streamWTV;					// if true, stream wtv files
+	StreamSizeTracker _sizeTracker;		// tracks the size of a growing live/rec ts stream file
 	long long _lastStreamSize;			// last value found for file stream
 	bool _isStreamFileGrowing;			// true if server reports that a live/rec stream is still growing
 	long long _readCnt;					// keep a count of the number of reads executed during playback
@@ -278,6 +278,19 @@ namespace Myth
       return m_wsapi.GetProgramGuide(chanid, starttime, endtime);
     }
 
+    /**
+     * @brief Query the guide information for a particular time period and a range of channels
+     * @param startchanid
+     * @param numchannels
+     * @param starttime
+     * @param endtime
+     * @return ProgramGuideMapPtr
+     */
+    ProgramGuideMapPtr GetProgramGuide(uint32_t startchanid, unsigned numchannels, time_t starttime, time_t endtime)
+    {
+      return m_wsapi.GetProgramGuide(startchanid, numchannels, starttime, endtime);
+    }
+
     /**
      * @brief Query all configured recording rules
      * @return RecordScheduleListPtr
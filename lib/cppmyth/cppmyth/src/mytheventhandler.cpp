@@ -25,9 +25,11 @@
 #include "private/builtin.h"
 #include "private/platform/threads/threads.h"
 #include "private/platform/util/util.h"
+#include "private/platform/util/timeutils.h"
 
 #include <vector>
 #include <map>
+#include <list>
 
 using namespace Myth;
 
@@ -46,6 +48,171 @@ EventHandler::EventHandlerThread::~EventHandlerThread()
 {
 }
 
+///////////////////////////////////////////////////////////////////////////////
+////
+//// SubscriptionHandlerThread
+////
+//// Each subscriber owns a queue of events and a thread calling its handler,
+//// so a slow subscriber does not delay the others.
+////
+
+namespace Myth
+{
+  class SubscriptionHandlerThread : private PLATFORM::CThread
+  {
+  public:
+    SubscriptionHandlerThread(EventSubscriber *handle, unsigned subid);
+    ~SubscriptionHandlerThread();
+    EventSubscriber *GetHandle() { return m_handle; }
+    bool Start();
+    void Stop();
+    void SetCoalescing(bool enable);
+    void PostMessage(const EventMessage& msg);
+
+  private:
+    struct Item
+    {
+      EventMessage msg;
+      int64_t posted;
+    };
+    struct Stats
+    {
+      unsigned count;       ///< Events handled
+      unsigned coalesced;   ///< Events dropped as duplicates
+      int64_t waitTotal;    ///< Time spent in queue (ms)
+      int64_t runTotal;     ///< Time spent in handler (ms)
+      int64_t maxLatency;   ///< Longest time from post to completion (ms)
+    };
+
+    EventSubscriber *m_handle;
+    unsigned m_subId;
+    bool m_coalesce;
+    PLATFORM::CMutex m_mutex;
+    PLATFORM::CEvent m_queueContent;
+    std::list<Item> m_queue;
+    std::map<EVENT_t, Stats> m_stats;
+
+    Stats& GetStats(EVENT_t event);
+    void LogStats();
+    void *Process(void);
+  };
+}
+
+SubscriptionHandlerThread::SubscriptionHandlerThread(EventSubscriber *handle, unsigned subid)
+: PLATFORM::CThread()
+, m_handle(handle)
+, m_subId(subid)
+, m_coalesce(false)
+{
+}
+
+SubscriptionHandlerThread::~SubscriptionHandlerThread()
+{
+  Stop();
+  LogStats();
+}
+
+bool SubscriptionHandlerThread::Start()
+{
+  if (PLATFORM::CThread::IsRunning())
+    return true;
+  return PLATFORM::CThread::CreateThread();
+}
+
+void SubscriptionHandlerThread::Stop()
+{
+  if (PLATFORM::CThread::IsRunning())
+  {
+    PLATFORM::CThread::StopThread(-1);
+    m_queueContent.Signal();
+    PLATFORM::CThread::StopThread(0);
+  }
+}
+
+void SubscriptionHandlerThread::SetCoalescing(bool enable)
+{
+  PLATFORM::CLockObject lock(m_mutex);
+  m_coalesce = enable;
+}
+
+void SubscriptionHandlerThread::PostMessage(const EventMessage& msg)
+{
+  PLATFORM::CLockObject lock(m_mutex);
+  // Only a repeat of the last queued event is dropped: an earlier match may be
+  // followed by an event that undoes it (e.g. DISCONNECTED, CONNECTED)
+  if (m_coalesce && !msg.program && !msg.signal && !m_queue.empty())
+  {
+    const EventMessage& last = m_queue.back().msg;
+    if (last.event == msg.event && last.subject == msg.subject && !last.program && !last.signal)
+    {
+      ++GetStats(msg.event).coalesced;
+      return;
+    }
+  }
+  Item item;
+  item.msg = msg;
+  item.posted = PLATFORM::GetTimeMs();
+  m_queue.push_back(item);
+  m_queueContent.Signal();
+}
+
+SubscriptionHandlerThread::Stats& SubscriptionHandlerThread::GetStats(EVENT_t event)
+{
+  std::map<EVENT_t, Stats>::iterator it = m_stats.find(event);
+  if (it == m_stats.end())
+  {
+    Stats stats = { 0, 0, 0, 0, 0 };
+    it = m_stats.insert(std::make_pair(event, stats)).first;
+  }
+  return it->second;
+}
+
+void SubscriptionHandlerThread::LogStats()
+{
+  PLATFORM::CLockObject lock(m_mutex);
+  for (std::map<EVENT_t, Stats>::const_iterator it = m_stats.begin(); it != m_stats.end(); ++it)
+  {
+    const Stats& st = it->second;
+    DBG(MYTH_DBG_DEBUG, "%s: subscriber (%u) event (%d): handled %u, coalesced %u, avg wait %" PRId64 " ms, avg run %" PRId64 " ms, max latency %" PRId64 " ms\n",
+            __FUNCTION__, m_subId, (int)it->first, st.count, st.coalesced,
+            (st.count ? st.waitTotal / st.count : 0), (st.count ? st.runTotal / st.count : 0), st.maxLatency);
+  }
+}
+
+void *SubscriptionHandlerThread::Process()
+{
+  while (!PLATFORM::CThread::IsStopped())
+  {
+    Item item;
+    {
+      PLATFORM::CLockObject lock(m_mutex);
+      if (m_queue.empty())
+      {
+        lock.Unlock();
+        m_queueContent.Wait(EVENTHANDLER_TIMEOUT * 1000);
+        continue;
+      }
+      item = m_queue.front();
+      m_queue.pop_front();
+    }
+    int64_t start = PLATFORM::GetTimeMs();
+    m_handle->HandleBackendMessage(item.msg);
+    int64_t end = PLATFORM::GetTimeMs();
+
+    PLATFORM::CLockObject lock(m_mutex);
+    Stats& st = GetStats(item.msg.event);
+    ++st.count;
+    st.waitTotal += start - item.posted;
+    st.runTotal += end - start;
+    if (end - item.posted > st.maxLatency)
+      st.maxLatency = end - item.posted;
+    if (end - item.posted > EVENTHANDLER_SLOW_MS)
+      DBG(MYTH_DBG_WARN, "%s: subscriber (%u) event (%d) handled after %" PRId64 " ms (run %" PRId64 " ms, queued %u)\n",
+              __FUNCTION__, m_subId, (int)item.msg.event, end - item.posted, end - start, (unsigned)m_queue.size());
+  }
+  return NULL;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ////
 //// BasicEventHandler
@@ -65,6 +232,7 @@ public:
   virtual unsigned CreateSubscription(EventSubscriber *sub);
   virtual bool SubscribeForEvent(unsigned subid, EVENT_t event);
   virtual void RevokeSubscription(unsigned subid);
+  virtual bool SetCoalescing(unsigned subid, bool enable);
 
 private:
   PLATFORM::CMutex *m_mutex;
@@ -73,7 +241,7 @@ private:
   // About subscriptions
   typedef std::map<EVENT_t, std::vector<unsigned> > subscriptionsByEvent_t;
   subscriptionsByEvent_t m_subscriptionsByEvent;
-  typedef std::map<unsigned, EventSubscriber*> subscriptions_t;
+  typedef std::map<unsigned, SubscriptionHandlerThread*> subscriptions_t;
   subscriptions_t m_subscriptions;
 
   void DispatchEvent(const EventMessage& msg);
@@ -94,6 +262,10 @@ BasicEventHandler::BasicEventHandler(const std::string& server, unsigned port)
 BasicEventHandler::~BasicEventHandler()
 {
   Stop();
+  // Stop subscriber threads, dropping pending events
+  for (subscriptions_t::iterator it = m_subscriptions.begin(); it != m_subscriptions.end(); ++it)
+    delete it->second;
+  m_subscriptions.clear();
   SAFE_DELETE(m_event);
   SAFE_DELETE(m_mutex);
 }
@@ -141,11 +313,17 @@ unsigned BasicEventHandler::CreateSubscription(EventSubscriber* sub)
   while (it != m_subscriptions.end())
   {
     id = it->first;
-    if (sub == it->second)
+    if (sub == it->second->GetHandle())
       return id;
     ++it;
   }
-  m_subscriptions.insert(std::make_pair(++id, sub));
+  SubscriptionHandlerThread *handler = new SubscriptionHandlerThread(sub, ++id);
+  if (!handler->Start())
+  {
+    delete handler;
+    return 0;
+  }
+  m_subscriptions.insert(std::make_pair(id, handler));
   return id;
 }
 
@@ -168,31 +346,49 @@ bool BasicEventHandler::SubscribeForEvent(unsigned subid, EVENT_t event)
 }
 
 void BasicEventHandler::RevokeSubscription(unsigned subid)
+{
+  SubscriptionHandlerThread *handler = NULL;
+  {
+    PLATFORM::CLockObject lock(*m_mutex);
+    subscriptions_t::iterator it;
+    it = m_subscriptions.find(subid);
+    if (it != m_subscriptions.end())
+    {
+      handler = it->second;
+      m_subscriptions.erase(it);
+    }
+  }
+  // Wait for the running handler to return outside the lock, so dispatching
+  // to other subscribers goes on
+  delete handler;
+}
+
+bool BasicEventHandler::SetCoalescing(unsigned subid, bool enable)
 {
   PLATFORM::CLockObject lock(*m_mutex);
-  subscriptions_t::iterator it;
-  it = m_subscriptions.find(subid);
-  if (it != m_subscriptions.end())
-    m_subscriptions.erase(it);
+  subscriptions_t::iterator it = m_subscriptions.find(subid);
+  if (it == m_subscriptions.end())
+    return false;
+  it->second->SetCoalescing(enable);
+  return true;
 }
 
 void BasicEventHandler::DispatchEvent(const EventMessage& msg)
 {
   PLATFORM::CLockObject lock(*m_mutex);
-  std::vector<std::vector<unsigned>::iterator> revoked;
-  std::vector<unsigned>::iterator it1 = m_subscriptionsByEvent[msg.event].begin();
-  while (it1 != m_subscriptionsByEvent[msg.event].end())
+  std::vector<unsigned>& subids = m_subscriptionsByEvent[msg.event];
+  std::vector<unsigned>::iterator it1 = subids.begin();
+  while (it1 != subids.end())
   {
     subscriptions_t::const_iterator it2 = m_subscriptions.find(*it1);
     if (it2 != m_subscriptions.end())
-      it2->second->HandleBackendMessage(msg);
+    {
+      it2->second->PostMessage(msg);
+      ++it1;
+    }
     else
-      revoked.push_back(it1);
-    ++it1;
+      it1 = subids.erase(it1); // revoked
   }
-  std::vector<std::vector<unsigned>::iterator>::const_iterator itr;
-  for (itr = revoked.begin(); itr != revoked.end(); ++itr)
-    m_subscriptionsByEvent[msg.event].erase(*itr);
 }
 
 void *BasicEventHandler::Process()
@@ -244,6 +440,7 @@ void BasicEventHandler::AnnounceTimer()
 {
   char buf[32];
   EventMessage msg;
+  buf[0] = 0;
   msg.event = EVENT_HANDLER_TIMER;
   msg.subject.push_back(buf);
   DispatchEvent(msg);
@@ -31,6 +31,7 @@
 #define EVENTHANDLER_STOPPED        "STOPPED"
 #define EVENTHANDLER_NOTCONNECTED   "NOTCONNECTED"
 #define EVENTHANDLER_TIMEOUT        1 // 1 sec
+#define EVENTHANDLER_SLOW_MS        1000  // warn when an event is handled later than that
 
 namespace Myth
 {
@@ -58,6 +59,11 @@ namespace Myth
     unsigned CreateSubscription(EventSubscriber *sub) { return m_imp->CreateSubscription(sub); }
     bool SubscribeForEvent(unsigned subid, EVENT_t event) { return m_imp->SubscribeForEvent(subid, event);}
     void RevokeSubscription(unsigned subid) { m_imp->RevokeSubscription(subid); }
+    /**
+     * @brief Drop events identical to the last one still queued for the subscriber
+     * @note Events carrying a program or a signal status are always queued
+     */
+    bool SetCoalescing(unsigned subid, bool enable) { return m_imp->SetCoalescing(subid, enable); }
 
     class EventHandlerThread
     {
@@ -75,6 +81,7 @@ namespace Myth
       virtual unsigned CreateSubscription(EventSubscriber *sub) = 0;
       virtual bool SubscribeForEvent(unsigned subid, EVENT_t event) = 0;
       virtual void RevokeSubscription(unsigned subid) = 0;
+      virtual bool SetCoalescing(unsigned subid, bool enable) = 0;
     protected:
       std::string m_server;
       unsigned m_port;
@@ -24,6 +24,7 @@
 #include "private/builtin.h"
 #include "private/mythsocket.h"
 #include "private/platform/threads/mutex.h"
+#include "private/platform/threads/threads.h"
 
 #include <limits>
 #include <cstdio>
@@ -33,9 +34,70 @@
 #define MAX_TUNE_DELAY        60
 #define TICK_USEC             100000  // valid range: 10000 - 999999
 #define STARTING_DELAY        1
+#define PREFETCH_IDLE_MS      1000    // prefetcher wait when there is nothing to fetch
+#define GROWTH_WAIT_MS        500     // reader wait for the recorder to grow the file
 
 using namespace Myth;
 
+///////////////////////////////////////////////////////////////////////////////
+////
+//// Prefetcher thread
+////
+//// Keeps the read-ahead buffer of the current transfer filled, and opens and
+//// fills the next transfer of the chain before the reader has to switch.
+////
+
+class LiveTVPlayback::Prefetcher : private PLATFORM::CThread
+{
+public:
+  Prefetcher(LiveTVPlayback& playback)
+  : PLATFORM::CThread()
+  , m_playback(playback)
+  {
+    CreateThread(false);
+  }
+
+  ~Prefetcher()
+  {
+    StopThread(-1);
+    m_wake.Signal();
+    StopThread(0);
+  }
+
+  void Wake()
+  {
+    m_wake.Signal();
+  }
+
+  void NotifyGrowth()
+  {
+    m_growth.Signal();
+    m_wake.Signal();
+  }
+
+  bool WaitGrowth(uint32_t timeout)
+  {
+    return m_growth.Wait(timeout);
+  }
+
+  PLATFORM::CMutex fetchLock;     ///< Serializes data requests on transfers
+
+private:
+  LiveTVPlayback& m_playback;
+  PLATFORM::CEvent m_wake;
+  PLATFORM::CEvent m_growth;
+
+  void *Process()
+  {
+    while (!IsStopped())
+    {
+      if (!m_playback.Prefetch())
+        m_wake.Wait(PREFETCH_IDLE_MS);
+    }
+    return NULL;
+  }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 ////
 //// Protocol connection to control LiveTV playback
@@ -48,8 +110,11 @@ LiveTVPlayback::LiveTVPlayback(EventHandler& handler)
 , m_tuneDelay(MIN_TUNE_DELAY)
 , m_recorder()
 , m_signal()
+, m_bufferSize(PROTO_TRANSFER_BUFFER)
+, m_prefetcher(NULL)
 , m_chain()
 {
+  m_prefetcher = new Prefetcher(*this);
   m_eventSubscriberId = m_eventHandler.CreateSubscription(this);
   m_eventHandler.SubscribeForEvent(m_eventSubscriberId, EVENT_SIGNAL);
   m_eventHandler.SubscribeForEvent(m_eventSubscriberId, EVENT_LIVETV_CHAIN);
@@ -66,8 +131,11 @@ LiveTVPlayback::LiveTVPlayback(const std::string& server, unsigned port)
 , m_tuneDelay(MIN_TUNE_DELAY)
 , m_recorder()
 , m_signal()
+, m_bufferSize(PROTO_TRANSFER_BUFFER)
+, m_prefetcher(NULL)
 , m_chain()
 {
+  m_prefetcher = new Prefetcher(*this);
   // Private handler will be stopped and closed by destructor.
   m_eventSubscriberId = m_eventHandler.CreateSubscription(this);
   m_eventHandler.SubscribeForEvent(m_eventSubscriberId, EVENT_SIGNAL);
@@ -82,6 +150,7 @@ LiveTVPlayback::~LiveTVPlayback()
 {
   if (m_eventSubscriberId)
     m_eventHandler.RevokeSubscription(m_eventSubscriberId);
+  delete m_prefetcher;
   Close();
 }
 
@@ -130,6 +199,15 @@ void LiveTVPlayback::SetTuneDelay(unsigned delay)
     m_tuneDelay = delay;
 }
 
+void LiveTVPlayback::SetBufferSize(unsigned size)
+{
+  PLATFORM::CLockObject lock(*m_mutex); // Lock chain
+  m_bufferSize = size;
+  PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
+  for (chained_t::const_iterator it = m_chain.chained.begin(); it != m_chain.chained.end(); ++it)
+    it->first->SetBufferSize(m_bufferSize);
+}
+
 bool LiveTVPlayback::SpawnLiveTV(const Channel& channel, uint32_t prefcardid)
 {
   int rnum = 0; // first selected recorder num
@@ -266,6 +344,7 @@ void LiveTVPlayback::HandleChainUpdate()
     DBG(MYTH_DBG_DEBUG, "%s: liveTV (%s): adding new transfer %s\n", __FUNCTION__,
             m_chain.UID.c_str(), prog->fileName.c_str());
     ProtoTransferPtr transfer(new ProtoTransfer(recorder->GetServer(), recorder->GetPort(), prog->fileName, prog->recording.storageGroup));
+    transfer->SetBufferSize(m_bufferSize);
     // Pop previous dummy file if exists then add the new into the chain
     if (m_chain.lastSequence && m_chain.chained[m_chain.lastSequence - 1].first->fileSize == 0)
     {
@@ -283,6 +362,8 @@ void LiveTVPlayback::HandleChainUpdate()
     m_chain.watch = false; // Chain update done. Restore watch flag
     DBG(MYTH_DBG_DEBUG, "%s: liveTV (%s): chain last (%u), watching (%u)\n", __FUNCTION__,
             m_chain.UID.c_str(), m_chain.lastSequence, m_chain.currentSequence);
+    // Wake up a reader waiting at the end of the previous file
+    m_prefetcher->NotifyGrowth();
   }
 }
 
@@ -292,9 +373,12 @@ bool LiveTVPlayback::SwitchChain(unsigned sequence)
   // Check for out of range
   if (sequence < 1 || sequence > m_chain.lastSequence)
     return false;
-  // If closed then try to open
-  if (!m_chain.chained[sequence - 1].first->IsOpen() && !m_chain.chained[sequence - 1].first->Open())
-    return false;
+  // If closed then try to open. The prefetcher could be opening it too
+  {
+    PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
+    if (!m_chain.chained[sequence - 1].first->IsOpen() && !m_chain.chained[sequence - 1].first->Open())
+      return false;
+  }
   m_chain.currentTransfer = m_chain.chained[sequence - 1].first;
   m_chain.currentSequence = sequence;
   DBG(MYTH_DBG_DEBUG, "%s: switch to file (%u) %s\n", __FUNCTION__,
@@ -308,12 +392,51 @@ bool LiveTVPlayback::SwitchChainLast()
   {
     ProtoRecorderPtr recorder(m_recorder);
     ProtoTransferPtr transfer(m_chain.currentTransfer);
+    PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
     if (recorder && transfer && recorder->TransferSeek(*transfer, 0, WHENCE_SET) == 0)
       return true;
   }
   return false;
 }
 
+bool LiveTVPlayback::Prefetch()
+{
+  ProtoRecorderPtr recorder(m_recorder);
+  ProtoTransferPtr transfer;
+  bool next = false;
+  if (!recorder || !recorder->IsPlaying())
+    return false;
+  {
+    PLATFORM::CLockObject lock(*m_mutex); // Lock chain
+    if (!m_chain.currentSequence)
+      return false;
+    unsigned i = m_chain.currentSequence - 1;
+    transfer = m_chain.chained[i].first;
+    /*
+     * Once the current file is fully requested go ahead with the next one,
+     * so switching to it does not wait for the transfer to open
+     */
+    if (transfer->fileRequest >= transfer->fileSize && i + 1 < m_chain.lastSequence)
+    {
+      transfer = m_chain.chained[i + 1].first;
+      next = true;
+    }
+  }
+  // Opening talks to the backend: do it without holding the chain
+  PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
+  if (next && !transfer->IsOpen())
+  {
+    if (!transfer->Open())
+      return false;
+    DBG(MYTH_DBG_DEBUG, "%s: liveTV: opened next file (%u) %s\n", __FUNCTION__,
+            (unsigned)transfer->GetFileId(), transfer->GetPathName().c_str());
+  }
+  if (!transfer->IsOpen() || transfer->fileRequest >= transfer->fileSize ||
+          transfer->GetBufferSpace() < PROTO_TRANSFER_RCVBUF)
+    return false;
+  return (recorder->TransferPrefetch(*transfer) > 0);
+}
+
 void LiveTVPlayback::HandleBackendMessage(const EventMessage& msg)
 {
   ProtoRecorderPtr recorder(m_recorder);
@@ -420,6 +543,7 @@ void LiveTVPlayback::HandleBackendMessage(const EventMessage& msg)
           {
             // Update transfer file size
             m_chain.chained[m_chain.lastSequence - 1].first->fileSize = newsize;
+            m_prefetcher->NotifyGrowth();
             // Is wait the filling before switching ?
             if (m_chain.switchOnCreate && SwitchChainLast())
               m_chain.switchOnCreate = false;
@@ -464,29 +588,42 @@ int LiveTVPlayback::Read(void* buffer, unsigned n)
   // Begin critical section
   // First of all i hold my shared resources using copies
   ProtoRecorderPtr recorder(m_recorder);
-  if (!m_chain.currentTransfer || !recorder)
+  ProtoTransferPtr transfer;
+  {
+    PLATFORM::CLockObject lock(*m_mutex); // Lock chain
+    transfer = m_chain.currentTransfer;
+  }
+  if (!transfer || !recorder)
     return -1;
 
   do
   {
     retry = false;
-    fs = m_chain.currentTransfer->fileSize;  // Current known fileSize
-    s = fs - m_chain.currentTransfer->filePosition; // Acceptable block size
+    fs = transfer->fileSize;  // Current known fileSize
+    s = fs - transfer->filePosition; // Acceptable block size
     if (s == 0)
     {
       // Reading ahead
       if (m_chain.currentSequence == m_chain.lastSequence)
       {
-        if ((rp = recorder->GetFilePosition()) > fs)
+        /*
+         * Wait for the recorder to grow the file, as notified by event
+         * UPDATE_FILE_SIZE, or for a new file in the chain. Without news
+         * from the backend ask the recorder for its position.
+         */
+        if (m_prefetcher->WaitGrowth(GROWTH_WAIT_MS) &&
+                (transfer->fileSize > fs || m_chain.currentSequence != m_chain.lastSequence))
+          retry = true;
+        else if ((rp = recorder->GetFilePosition()) > fs)
         {
           PLATFORM::CLockObject lock(*m_mutex); // Lock chain
-          m_chain.currentTransfer->fileSize = rp;
+          if (transfer->fileSize < rp)
+            transfer->fileSize = rp;
           retry = true;
         }
         else
         {
           DBG(MYTH_DBG_WARN, "%s: read position is ahead (%" PRIi64 ")\n", __FUNCTION__, fs);
-          usleep(100000); // timeshift +100ms
           return 0;
         }
       }
@@ -495,8 +632,15 @@ int LiveTVPlayback::Read(void* buffer, unsigned n)
       {
         if (!SwitchChain(m_chain.currentSequence + 1))
           return -1;
-        if (m_chain.currentTransfer->filePosition != 0)
-          recorder->TransferSeek(*(m_chain.currentTransfer), 0, WHENCE_SET);
+        {
+          PLATFORM::CLockObject lock(*m_mutex); // Lock chain
+          transfer = m_chain.currentTransfer;
+        }
+        if (transfer->filePosition != 0)
+        {
+          PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
+          recorder->TransferSeek(*transfer, 0, WHENCE_SET);
+        }
         retry = true;
         DBG(MYTH_DBG_DEBUG, "%s: liveTV (%s): chain last (%u), watching (%u)\n", __FUNCTION__,
               m_chain.UID.c_str(), m_chain.lastSequence, m_chain.currentSequence);
@@ -510,7 +654,12 @@ int LiveTVPlayback::Read(void* buffer, unsigned n)
   if (s < (int64_t)n)
     n = (unsigned)s ;
 
-  r = recorder->TransferRequestBlock(*(m_chain.currentTransfer), buffer, n);
+  {
+    PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
+    r = recorder->TransferRequestBlock(*transfer, buffer, n);
+  }
+  // Refill the room made in the buffer
+  m_prefetcher->Wake();
   return r;
 }
 
@@ -550,6 +699,7 @@ int64_t LiveTVPlayback::Seek(int64_t offset, WHENCE_t whence)
       if (position - m_chain.chained[ci].first->filePosition + m_chain.chained[ci].first->fileSize >= p)
       {
         // Try seek file to desired position. On success switch chain
+        PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
         if (m_recorder->TransferSeek(*(m_chain.chained[ci].first), p - position, WHENCE_CUR) < 0 ||
                 !SwitchChain(++ci))
           return -1;
@@ -570,6 +720,7 @@ int64_t LiveTVPlayback::Seek(int64_t offset, WHENCE_t whence)
       if (position - m_chain.chained[ci].first->filePosition <= p)
       {
         // Try seek file to desired position. On success switch chain
+        PLATFORM::CLockObject fetch(m_prefetcher->fetchLock);
         if (m_recorder->TransferSeek(*(m_chain.chained[ci].first), p - position, WHENCE_CUR) < 0 ||
                 !SwitchChain(++ci))
           return -1;
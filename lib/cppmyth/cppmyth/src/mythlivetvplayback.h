@@ -45,6 +45,10 @@ namespace Myth
     void Close();
     bool IsOpen() { return ProtoMonitor::IsOpen(); }
     void SetTuneDelay(unsigned delay);
+    /**
+     * @brief Size of the buffer filled ahead of the reader for each file of the chain
+     */
+    void SetBufferSize(unsigned size);
     bool SpawnLiveTV(const Channel& channel, uint32_t prefcardid = 0);
     void StopLiveTV();
 
@@ -68,12 +72,17 @@ namespace Myth
     void HandleBackendMessage(const EventMessage& msg);
 
   private:
+    class Prefetcher;
+    friend class Prefetcher;
+
     EventHandler m_eventHandler;
     unsigned m_eventSubscriberId;
 
     unsigned m_tuneDelay;
     ProtoRecorderPtr m_recorder;
     SignalStatusPtr m_signal;
+    unsigned m_bufferSize;
+    Prefetcher *m_prefetcher;
 
     typedef std::vector<std::pair<ProtoTransferPtr, ProgramPtr> > chained_t;
     struct {
@@ -93,6 +102,7 @@ namespace Myth
     void HandleChainUpdate();
     bool SwitchChain(unsigned sequence);
     bool SwitchChainLast();
+    bool Prefetch();
   };
 
 }
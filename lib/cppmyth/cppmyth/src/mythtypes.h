@@ -303,6 +303,8 @@ namespace Myth
   typedef MYTH_SHARED_PTR<ProgramList> ProgramListPtr;
   typedef std::map<time_t, ProgramPtr> ProgramMap;
   typedef MYTH_SHARED_PTR<ProgramMap> ProgramMapPtr;
+  typedef std::map<uint32_t, ProgramMapPtr> ProgramGuideMap;  ///< Programs by channel id
+  typedef MYTH_SHARED_PTR<ProgramGuideMap> ProgramGuideMapPtr;
 
   struct CaptureCard
   {
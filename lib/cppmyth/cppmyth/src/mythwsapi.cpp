@@ -652,7 +652,16 @@ ChannelListPtr WSAPI::GetChannelList1_5(uint32_t sourceid, bool onlyVisible)
 ////
 ProgramMapPtr WSAPI::GetProgramGuide1_0(uint32_t chanid, time_t starttime, time_t endtime)
 {
-  ProgramMapPtr ret(new ProgramMap);
+  ProgramGuideMapPtr guide = GetProgramGuide1_0(chanid, 1, starttime, endtime);
+  ProgramGuideMap::iterator it = guide->find(chanid);
+  if (it == guide->end() || !it->second)
+    return ProgramMapPtr(new ProgramMap);
+  return it->second;
+}
+
+ProgramGuideMapPtr WSAPI::GetProgramGuide1_0(uint32_t startchanid, unsigned numchannels, time_t starttime, time_t endtime)
+{
+  ProgramGuideMapPtr ret(new ProgramGuideMap);
   char buf[32];
   int32_t count = 0;
   unsigned proto = (unsigned)m_version.protocol;
@@ -666,9 +675,10 @@ ProgramMapPtr WSAPI::GetProgramGuide1_0(uint32_t chanid, time_t starttime, time_
   WSRequest req = WSRequest(m_server, m_port);
   req.RequestAccept(CT_JSON);
   req.RequestService("/Guide/GetProgramGuide");
-  uint32str(chanid, buf);
+  uint32str(startchanid, buf);
   req.SetContentParam("StartChanId", buf);
-  req.SetContentParam("NumChannels", "1");
+  uint32str(numchannels, buf);
+  req.SetContentParam("NumChannels", buf);
   time2iso8601utc(starttime, buf);
   req.SetContentParam("StartTime", buf);
   time2iso8601utc(endtime, buf);
@@ -707,6 +717,9 @@ ProgramMapPtr WSAPI::GetProgramGuide1_0(uint32_t chanid, time_t starttime, time_
     const json_t *chan = json_array_get(chans, ci);
     Channel channel;
     MythJSON::BindObject(chan, &channel, bindchan);
+    ProgramMapPtr& programs = (*ret)[channel.chanId];
+    if (!programs)
+      programs.reset(new ProgramMap);
     // Object: Programs[]
     const json_t *progs = json_object_get(chan, "Programs");
     // Iterates over the sequence elements.
@@ -718,10 +731,10 @@ ProgramMapPtr WSAPI::GetProgramGuide1_0(uint32_t chanid, time_t starttime, time_
       // Bind the new program
       MythJSON::BindObject(prog, program.get(), bindprog);
       program->channel = channel;
-      ret->insert(std::make_pair(program->startTime, program));
+      programs->insert(std::make_pair(program->startTime, program));
     }
   }
-  DBG(MYTH_DBG_DEBUG, "%s: received count(%d)\n", __FUNCTION__, count);
+  DBG(MYTH_DBG_DEBUG, "%s: received channels(%u) count(%d)\n", __FUNCTION__, (unsigned)ret->size(), count);
 
   return ret;
 }
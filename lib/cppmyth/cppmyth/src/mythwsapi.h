@@ -148,6 +148,18 @@ namespace Myth
       return ProgramMapPtr(new ProgramMap);
     }
 
+    /**
+     * @brief GET Guide/GetProgramGuide for a range of channels
+     * @param startchanid lowest channel id of the range
+     * @param numchannels count of channels in the range, ordered by channel id
+     */
+    ProgramGuideMapPtr GetProgramGuide(uint32_t startchanid, unsigned numchannels, time_t starttime, time_t endtime)
+    {
+      WSServiceVersion_t wsv = CheckService(WS_Guide);
+      if (wsv.ranking >= 0x00010000) return GetProgramGuide1_0(startchanid, numchannels, starttime, endtime);
+      return ProgramGuideMapPtr(new ProgramGuideMap);
+    }
+
     /**
      * @brief GET Dvr/GetRecordedList
      */
@@ -380,6 +392,7 @@ namespace Myth
     ChannelListPtr GetChannelList1_5(uint32_t sourceid, bool onlyVisible);
 
     ProgramMapPtr GetProgramGuide1_0(uint32_t chanid, time_t starttime, time_t endtime);
+    ProgramGuideMapPtr GetProgramGuide1_0(uint32_t startchanid, unsigned numchannels, time_t starttime, time_t endtime);
 
     ProgramListPtr GetRecordedList1_5(unsigned n, bool descending);
     ProgramPtr GetRecorded1_5(uint32_t chanid, time_t recstartts);
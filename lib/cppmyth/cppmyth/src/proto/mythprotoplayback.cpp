@@ -24,6 +24,7 @@
 #include "../private/builtin.h"
 #include "../private/mythsocket.h"
 #include "../private/platform/threads/mutex.h"
+#include "../private/platform/util/timeutils.h"
 
 #include <limits>
 #include <cstdio>
@@ -144,15 +145,40 @@ bool ProtoPlayback::TransferIsOpen75(ProtoTransfer& transfer)
 
 int ProtoPlayback::TransferRequestBlock(ProtoTransfer& transfer, void *buffer, unsigned n)
 {
-  bool request = false, data = false;
+  if (n == 0)
+    return n;
+
+  // Serve data read ahead first
+  if (transfer.GetBuffered() > 0)
+  {
+    unsigned s = transfer.ReadBuffer(buffer, n);
+    DBG(MYTH_DBG_DEBUG, "%s: data read from buffer (%u)\n", __FUNCTION__, s);
+    return (int)s;
+  }
+  return TransferFetch(transfer, buffer, n);
+}
+
+int ProtoPlayback::TransferPrefetch(ProtoTransfer& transfer)
+{
+  unsigned buffered = transfer.GetBuffered();
+  if (transfer.GetBufferSpace() == 0)
+    return 0;
+  if (TransferFetch(transfer, NULL, 0) < 0)
+    return -1;
+  return (int)(transfer.GetBuffered() - buffered);
+}
+
+int ProtoPlayback::TransferFetch(ProtoTransfer& transfer, void *buffer, unsigned n)
+{
+  // Note: Data goes to the caller's buffer first (n bytes), then to the
+  // read-ahead buffer of the transfer
+  bool locked = false, eof = false;
   int r = 0, nfds = 0, fdc, fdd;
   char *p = (char*)buffer;
   struct timeval tv;
   fd_set fds;
-  unsigned s = 0;
-
-  if (n == 0)
-    return n;
+  unsigned s = 0, pending = 0, received = 0;
+  int64_t ahead, start;
 
   fdc = GetSocket();
   if (INVALID_SOCKET_VALUE == (tcp_socket_t)fdc)
@@ -160,26 +186,50 @@ int ProtoPlayback::TransferRequestBlock(ProtoTransfer& transfer, void *buffer, u
   fdd = transfer.GetSocket();
   if (INVALID_SOCKET_VALUE == (tcp_socket_t)fdd)
     return -1;
-  // Max size is RCVBUF size
-  if (n > PROTO_TRANSFER_RCVBUF)
-    n = PROTO_TRANSFER_RCVBUF;
-  if ((transfer.filePosition + n) > transfer.fileRequest)
+
+  // Size the read-ahead: at least the requested block, no more than the
+  // buffer takes, and within the known file size when the block allows
+  ahead = transfer.GetReadAheadSize();
+  if (ahead < (int64_t)n)
+    ahead = n;
+  if (ahead > (int64_t)n + transfer.GetBufferSpace())
+    ahead = (int64_t)n + transfer.GetBufferSpace();
+  if (ahead > transfer.fileSize - transfer.fileRequest)
+    ahead = (transfer.fileSize - transfer.fileRequest > (int64_t)n ? transfer.fileSize - transfer.fileRequest : n);
+  // Data requested before but still in the socket comes first
+  ahead -= transfer.fileRequest - transfer.filePosition - transfer.GetBuffered();
+
+  start = PLATFORM::GetTimeMs();
+  if (ahead > 0)
   {
-    // Begin critical section
+    // Begin critical section until the last feedback
     m_mutex->Lock();
-    bool ok = TransferRequestBlock75(transfer, n);
-    if (!ok)
+    locked = true;
+  }
+
+  for (;;)
+  {
+    // Keep up to PROTO_TRANSFER_PIPELINE requests outstanding, so the backend
+    // streams blocks back to back instead of waiting a round trip for each
+    while (locked && !eof && ahead > 0 && pending < PROTO_TRANSFER_PIPELINE)
     {
+      unsigned block = (ahead > PROTO_TRANSFER_RCVBUF ? PROTO_TRANSFER_RCVBUF : (unsigned)ahead);
+      if (!TransferRequestBlock75(transfer, block))
+        goto err;
+      ahead -= block;
+      ++pending;
+    }
+    if (locked && pending == 0)
+    {
+      locked = false;
       m_mutex->Unlock();
-      goto err;
     }
-    request = true;
-  }
+    // Done when all feedbacks are in and all data they announced is received
+    if (!pending && transfer.fileRequest <= transfer.filePosition + transfer.GetBuffered())
+      break;
 
-  do
-  {
     FD_ZERO(&fds);
-    if (request)
+    if (pending)
     {
       FD_SET((tcp_socket_t)fdc, &fds);
       if (nfds < fdc)
@@ -188,19 +238,9 @@ int ProtoPlayback::TransferRequestBlock(ProtoTransfer& transfer, void *buffer, u
     FD_SET((tcp_socket_t)fdd, &fds);
     if (nfds < fdd)
       nfds = fdd;
-
-    if (data)
-    {
-      // Read directly to get all queued packets
-      tv.tv_sec = 0;
-      tv.tv_usec = 0;
-    }
-    else
-    {
-      // Wait and read for new packet
-      tv.tv_sec = 10;
-      tv.tv_usec = 0;
-    }
+    // Wait and read for new packet
+    tv.tv_sec = 10;
+    tv.tv_usec = 0;
 
     r = select (nfds + 1, &fds, NULL, NULL, &tv);
     if (r < 0)
@@ -208,50 +248,72 @@ int ProtoPlayback::TransferRequestBlock(ProtoTransfer& transfer, void *buffer, u
       DBG(MYTH_DBG_ERROR, "%s: select error (%d)\n", __FUNCTION__, r);
       goto err;
     }
-    if (r == 0 && !data)
+    if (r == 0)
     {
       DBG(MYTH_DBG_ERROR, "%s: select timeout\n", __FUNCTION__);
       goto err;
     }
-    // Check for data
-    data = false;
+    // Check for data: fill the caller's buffer, then the read-ahead buffer
     if (FD_ISSET((tcp_socket_t)fdd, &fds))
     {
-      r = recv((tcp_socket_t)fdd, p, (size_t)(n - s), 0);
+      if (s < n)
+      {
+        r = recv((tcp_socket_t)fdd, p, (size_t)(n - s), 0);
+        if (r > 0)
+        {
+          s += r;
+          p += r;
+          transfer.filePosition += r;
+        }
+      }
+      else
+      {
+        unsigned len = 0;
+        char *tail = transfer.GetBufferTail(&len);
+        if (len == 0)
+        {
+          DBG(MYTH_DBG_ERROR, "%s: read-ahead buffer overflow\n", __FUNCTION__);
+          goto err;
+        }
+        r = recv((tcp_socket_t)fdd, tail, (size_t)len, 0);
+        if (r > 0)
+          transfer.CommitBuffer(r);
+      }
       if (r < 0)
       {
         DBG(MYTH_DBG_ERROR, "%s: recv data error (%d)\n", __FUNCTION__, r);
         goto err;
       }
       if (r > 0)
-      {
-        data = true;
-        s += r;
-        p += r;
-        transfer.filePosition += r;
-      }
+        received += r;
     }
     // Check for response of request
-    if (request && FD_ISSET((tcp_socket_t)fdc, &fds))
+    if (pending && FD_ISSET((tcp_socket_t)fdc, &fds))
     {
       int32_t rlen = TransferRequestBlockFeedback75();
-      request = false; // request is completed
-      m_mutex->Unlock();
+      --pending; // request is completed
       if (rlen < 0)
         goto err;
       DBG(MYTH_DBG_DEBUG, "%s: receive block size (%u)\n", __FUNCTION__, (unsigned)rlen);
-      if (rlen == 0 && !data)
-        break; // no more data
+      if (rlen == 0)
+        eof = true; // no more data
       transfer.fileRequest += rlen;
     }
-  } while (request || data || !s);
-  DBG(MYTH_DBG_DEBUG, "%s: data read (%u)\n", __FUNCTION__, s);
+  }
+  if (received > 0)
+    transfer.UpdateReadAhead(received, PLATFORM::GetTimeMs() - start);
+  DBG(MYTH_DBG_DEBUG, "%s: data read (%u), buffered (%u)\n", __FUNCTION__, s, transfer.GetBuffered());
   return (int)s;
 err:
-  if (request)
+  if (locked)
   {
-    if (RcvMessageLength())
+    // Drain feedbacks still pending on the control connection
+    while (pending-- > 0)
+    {
+      if (!RcvMessageLength())
+        break;
       FlushMessage();
+    }
     m_mutex->Unlock();
   }
   // Recover the file position or die
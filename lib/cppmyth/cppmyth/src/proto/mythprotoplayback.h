@@ -48,6 +48,11 @@ namespace Myth
       return TransferIsOpen75(transfer);
     }
     int TransferRequestBlock(ProtoTransfer& transfer, void *buffer, unsigned n);
+    /**
+     * @brief Fill the read-ahead buffer of the transfer without reading it
+     * @return number of bytes fetched, -1 on error
+     */
+    int TransferPrefetch(ProtoTransfer& transfer);
     int64_t TransferSeek(ProtoTransfer& transfer, int64_t offset, WHENCE_t whence)
     {
       return TransferSeek75(transfer, offset, whence);
@@ -55,6 +60,7 @@ namespace Myth
 
   private:
     bool Announce75();
+    int TransferFetch(ProtoTransfer& transfer, void *buffer, unsigned n);
     void TransferDone75(ProtoTransfer& transfer);
     bool TransferIsOpen75(ProtoTransfer& transfer);
     bool TransferRequestBlock75(ProtoTransfer& transfer, unsigned n);
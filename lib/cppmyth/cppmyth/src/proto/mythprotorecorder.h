@@ -69,6 +69,10 @@ namespace Myth
     {
       return ProtoPlayback::TransferRequestBlock(transfer, buffer, n);
     }
+    int TransferPrefetch(ProtoTransfer& transfer)
+    {
+      return ProtoPlayback::TransferPrefetch(transfer);
+    }
     int64_t TransferSeek(ProtoTransfer& transfer, int64_t offset, WHENCE_t whence)
     {
       return ProtoPlayback::TransferSeek(transfer, offset, whence);
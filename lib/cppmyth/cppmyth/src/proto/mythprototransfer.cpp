@@ -27,6 +27,7 @@
 
 #include <limits>
 #include <cstdio>
+#include <cstring>
 
 using namespace Myth;
 
@@ -43,9 +44,19 @@ ProtoTransfer::ProtoTransfer(const std::string& server, unsigned port, const std
 , m_fileId(0)
 , m_pathName(pathname)
 , m_storageGroupName(sgname)
+, m_buffer(NULL)
+, m_bufferSize(PROTO_TRANSFER_BUFFER)
+, m_bufferHead(0)
+, m_bufferLength(0)
+, m_readAheadSize(2 * PROTO_TRANSFER_RCVBUF)
 {
 }
 
+ProtoTransfer::~ProtoTransfer()
+{
+  delete[] m_buffer;
+}
+
 bool ProtoTransfer::Open()
 {
   bool ok = false;
@@ -75,6 +86,7 @@ void ProtoTransfer::Close()
   // Reset transfer
   filePosition = fileRequest = 0;
   m_fileId = 0;
+  ResetBuffer();
 }
 
 void ProtoTransfer::Lock()
@@ -94,7 +106,9 @@ bool ProtoTransfer::TryLock()
 
 void ProtoTransfer::Flush()
 {
-  int64_t unread = fileRequest - filePosition;
+  // Data still in the socket follows data already buffered
+  int64_t unread = fileRequest - filePosition - m_bufferLength;
+  ResetBuffer();
   if (unread > 0)
   {
     char buf[PROTO_BUFFER_SIZE];
@@ -107,9 +121,119 @@ void ProtoTransfer::Flush()
       n -= s;
     }
     DBG(MYTH_DBG_DEBUG, "%s: remaining bytes (%u)\n", __FUNCTION__, (unsigned)n);
-    // Reset position regardless bytes read
-    filePosition = fileRequest;
   }
+  // Reset position regardless bytes read
+  filePosition = fileRequest;
+}
+
+void ProtoTransfer::ResetBuffer()
+{
+  m_bufferHead = m_bufferLength = 0;
+}
+
+unsigned ProtoTransfer::GetBuffered() const
+{
+  return m_bufferLength;
+}
+
+unsigned ProtoTransfer::GetBufferSpace() const
+{
+  return m_bufferSize - m_bufferLength;
+}
+
+unsigned ProtoTransfer::GetBufferSize() const
+{
+  return m_bufferSize;
+}
+
+bool ProtoTransfer::SetBufferSize(unsigned size)
+{
+  if (size < PROTO_TRANSFER_RCVBUF)
+    size = PROTO_TRANSFER_RCVBUF;
+  if (size == m_bufferSize)
+    return true;
+  // Unread data must fit in the new buffer
+  if (m_bufferLength > size)
+    return false;
+  char *buffer = NULL;
+  if (m_buffer)
+  {
+    // Move unread data to the front of the new buffer
+    buffer = new char[size];
+    unsigned len = m_bufferSize - m_bufferHead;
+    if (len > m_bufferLength)
+      len = m_bufferLength;
+    memcpy(buffer, m_buffer + m_bufferHead, len);
+    memcpy(buffer + len, m_buffer, m_bufferLength - len);
+    delete[] m_buffer;
+  }
+  m_buffer = buffer;
+  m_bufferSize = size;
+  m_bufferHead = 0;
+  if (m_readAheadSize > m_bufferSize)
+    m_readAheadSize = m_bufferSize;
+  return true;
+}
+
+unsigned ProtoTransfer::ReadBuffer(void *buffer, unsigned n)
+{
+  char *p = (char*)buffer;
+  unsigned s = 0;
+  while (s < n && m_bufferLength > 0)
+  {
+    unsigned len = m_bufferSize - m_bufferHead;
+    if (len > m_bufferLength)
+      len = m_bufferLength;
+    if (len > n - s)
+      len = n - s;
+    memcpy(p, m_buffer + m_bufferHead, len);
+    p += len;
+    s += len;
+    m_bufferHead = (m_bufferHead + len) % m_bufferSize;
+    m_bufferLength -= len;
+  }
+  if (m_bufferLength == 0)
+    m_bufferHead = 0;
+  filePosition += s;
+  return s;
+}
+
+char *ProtoTransfer::GetBufferTail(unsigned *len)
+{
+  if (!m_buffer)
+    m_buffer = new char[m_bufferSize];
+  unsigned tail = (m_bufferHead + m_bufferLength) % m_bufferSize;
+  if (tail < m_bufferHead || m_bufferLength == m_bufferSize)
+    *len = m_bufferHead - tail;
+  else
+    *len = m_bufferSize - tail;
+  return m_buffer + tail;
+}
+
+void ProtoTransfer::CommitBuffer(unsigned n)
+{
+  m_bufferLength += n;
+}
+
+unsigned ProtoTransfer::GetReadAheadSize() const
+{
+  return m_readAheadSize;
+}
+
+void ProtoTransfer::UpdateReadAhead(unsigned n, int64_t ms)
+{
+  if (ms <= 0)
+    ms = 1;
+  // Request what the link delivers in PROTO_TRANSFER_AHEAD_MS, so the size
+  // grows with the throughput it measures
+  int64_t size = (int64_t)n * PROTO_TRANSFER_AHEAD_MS / ms;
+  if (size < PROTO_TRANSFER_RCVBUF)
+    size = PROTO_TRANSFER_RCVBUF;
+  else if (size > m_bufferSize)
+    size = m_bufferSize;
+  // Smooth the changes
+  m_readAheadSize = (unsigned)((m_readAheadSize + size) / 2);
+  DBG(MYTH_DBG_DEBUG, "%s: %u bytes in %" PRId64 " ms, read-ahead (%u)\n", __FUNCTION__, n, ms, m_readAheadSize);
 }
 
 bool ProtoTransfer::Announce75()
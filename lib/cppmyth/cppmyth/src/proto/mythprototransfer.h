@@ -25,6 +25,9 @@
 #include "mythprotobase.h"
 
 #define PROTO_TRANSFER_RCVBUF     64000
+#define PROTO_TRANSFER_BUFFER     (16 * PROTO_TRANSFER_RCVBUF)  ///< Default size of read-ahead buffer
+#define PROTO_TRANSFER_PIPELINE   4     ///< Max block requests outstanding
+#define PROTO_TRANSFER_AHEAD_MS   250   ///< Read-ahead to fetch at measured throughput
 
 namespace Myth
 {
@@ -36,6 +39,7 @@ namespace Myth
   {
   public:
     ProtoTransfer(const std::string& server, unsigned port, const std::string& pathname, const std::string& sgname);
+    ~ProtoTransfer();
 
     bool Open();
     void Close();
@@ -49,6 +53,50 @@ namespace Myth
      */
     void Flush();
 
+    /**
+     * @brief Number of bytes received ahead of the read position
+     */
+    unsigned GetBuffered() const;
+    /**
+     * @brief Free space left in the read-ahead buffer
+     */
+    unsigned GetBufferSpace() const;
+    /**
+     * @brief Capacity of the read-ahead buffer
+     */
+    unsigned GetBufferSize() const;
+    /**
+     * @brief Resize the read-ahead buffer, keeping unread data
+     * @param size new capacity, at least PROTO_TRANSFER_RCVBUF
+     * @return false if unread data does not fit in the new size
+     */
+    bool SetBufferSize(unsigned size);
+    /**
+     * @brief Consume data from the read-ahead buffer, advancing the read position
+     * @return number of bytes copied
+     */
+    unsigned ReadBuffer(void *buffer, unsigned n);
+    /**
+     * @brief Contiguous free space at the tail of the read-ahead buffer
+     * @param len receives the size of the space
+     * @return pointer to the space
+     */
+    char *GetBufferTail(unsigned *len);
+    /**
+     * @brief Account for data written at the tail of the read-ahead buffer
+     */
+    void CommitBuffer(unsigned n);
+    /**
+     * @brief Number of bytes to request when the read-ahead buffer runs dry
+     */
+    unsigned GetReadAheadSize() const;
+    /**
+     * @brief Adapt the read-ahead size to the throughput of the last fill
+     * @param n bytes received
+     * @param ms time taken
+     */
+    void UpdateReadAhead(unsigned n, int64_t ms);
+
     uint32_t GetFileId() const;
     std::string GetPathName() const;
     std::string GetStorageGroupName() const;
@@ -61,8 +109,14 @@ namespace Myth
     uint32_t m_fileId;
     std::string m_pathName;
     std::string m_storageGroupName;
+    char *m_buffer;                   ///< Read-ahead ring buffer
+    unsigned m_bufferSize;            ///< Capacity of the ring buffer
+    unsigned m_bufferHead;            ///< Offset of first unread byte
+    unsigned m_bufferLength;          ///< Count of unread bytes
+    unsigned m_readAheadSize;         ///< Bytes to request on next fill
 
     bool Announce75();
+    void ResetBuffer();
   };
 
 }